@@ -0,0 +1,177 @@
+#include "header.h"
+
+// Global allocation tracking, only compiled in with `make TRACK_ALLOC=1`.
+// Without MONITOR_TRACK_ALLOC this file is empty and ALLOC_SCOPE expands to nothing.
+#ifdef MONITOR_TRACK_ALLOC
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int MAX_ALLOC_SCOPES = 32;
+
+// Counters for the calling thread; AllocScope diffs them, so scopes on
+// different threads don't see each other's allocations
+static thread_local long long threadAllocs = 0;
+static thread_local long long threadBytes = 0;
+
+static atomic<long long> totalAllocs(0);
+static atomic<long long> totalFrees(0);
+static atomic<long long> totalBytes(0);
+static atomic<long long> liveBytes(0);
+
+struct ScopeSlot {
+    const char* name;
+    atomic<long long> allocs;   // since the last allocFrameEnd()
+    atomic<long long> bytes;
+};
+
+static ScopeSlot scopeSlots[MAX_ALLOC_SCOPES];
+static atomic<int> scopeCount(0);
+static AllocStats lastFrame;
+static AllocStats lastScopes[MAX_ALLOC_SCOPES];
+static long long frameStartAllocs = 0;
+static long long frameStartBytes = 0;
+
+static void* trackedAlloc(size_t size, size_t alignment)
+{
+    if (size == 0) size = 1;
+    void* p;
+    if (alignment > alignof(max_align_t)) {
+        p = aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+    } else {
+        p = malloc(size);
+    }
+    if (p == nullptr) return nullptr;
+
+    size_t usable = malloc_usable_size(p);
+    threadAllocs++;
+    threadBytes += size;
+    totalAllocs.fetch_add(1, memory_order_relaxed);
+    totalBytes.fetch_add(size, memory_order_relaxed);
+    liveBytes.fetch_add(usable, memory_order_relaxed);
+    return p;
+}
+
+static void trackedFree(void* p)
+{
+    if (p == nullptr) return;
+    totalFrees.fetch_add(1, memory_order_relaxed);
+    liveBytes.fetch_sub(malloc_usable_size(p), memory_order_relaxed);
+    free(p);
+}
+
+int allocScopeSlot(const char* name)
+{
+    // Call sites cache their slot in a function-local static, so this runs once per site
+    static mutex lock;
+    lock_guard<mutex> guard(lock);
+    int n = scopeCount.load();
+    for (int i = 0; i < n; i++) {
+        if (strcmp(scopeSlots[i].name, name) == 0) return i;
+    }
+    if (n >= MAX_ALLOC_SCOPES) return -1;
+    scopeSlots[n].name = name;
+    scopeCount.store(n + 1);
+    return n;
+}
+
+AllocScope::AllocScope(int slot) : slot(slot), allocs(threadAllocs), bytes(threadBytes) {}
+
+AllocScope::~AllocScope()
+{
+    if (slot < 0) return;
+    scopeSlots[slot].allocs.fetch_add(threadAllocs - allocs, memory_order_relaxed);
+    scopeSlots[slot].bytes.fetch_add(threadBytes - bytes, memory_order_relaxed);
+}
+
+void allocFrameEnd()
+{
+    long long allocs = totalAllocs.load(memory_order_relaxed);
+    long long bytes = totalBytes.load(memory_order_relaxed);
+    lastFrame.name = "frame";
+    lastFrame.allocs = allocs - frameStartAllocs;
+    lastFrame.bytes = bytes - frameStartBytes;
+    frameStartAllocs = allocs;
+    frameStartBytes = bytes;
+
+    int n = scopeCount.load();
+    for (int i = 0; i < n; i++) {
+        lastScopes[i].name = scopeSlots[i].name;
+        lastScopes[i].allocs = scopeSlots[i].allocs.exchange(0, memory_order_relaxed);
+        lastScopes[i].bytes = scopeSlots[i].bytes.exchange(0, memory_order_relaxed);
+    }
+}
+
+AllocStats allocLastFrame()
+{
+    return lastFrame;
+}
+
+int allocLastScopes(const AllocStats** scopes)
+{
+    *scopes = lastScopes;
+    return scopeCount.load();
+}
+
+AllocTotals allocTotals()
+{
+    AllocTotals t;
+    t.allocs = totalAllocs.load(memory_order_relaxed);
+    t.frees = totalFrees.load(memory_order_relaxed);
+    t.bytes = totalBytes.load(memory_order_relaxed);
+    t.live_bytes = liveBytes.load(memory_order_relaxed);
+    return t;
+}
+
+// Replacements for every global allocation function; the sized and aligned
+// deletes all end up in trackedFree since malloc knows the block size.
+void* operator new(size_t size)
+{
+    void* p = trackedAlloc(size, 0);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+    return trackedAlloc(size, 0);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+    return trackedAlloc(size, 0);
+}
+
+void* operator new(size_t size, align_val_t alignment)
+{
+    void* p = trackedAlloc(size, (size_t)alignment);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept { trackedFree(p); }
+void operator delete[](void* p) noexcept { trackedFree(p); }
+void operator delete(void* p, size_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, size_t) noexcept { trackedFree(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { trackedFree(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { trackedFree(p); }
+void operator delete(void* p, align_val_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, align_val_t) noexcept { trackedFree(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { trackedFree(p); }
+
+#endif // MONITOR_TRACK_ALLOC
@@ -0,0 +1,57 @@
+#include "header.h"
+
+// Bump allocator over one block that is reused every frame.
+// Requests that don't fit go to the heap and are remembered, so the next reset
+// can grow the block to cover them; after a frame or two of warm-up, frames
+// allocate nothing from the heap at all.
+struct FrameArena : public pmr::memory_resource {
+    char* block;
+    size_t capacity;
+    size_t used;
+    size_t overflow;    // bytes that went to the heap since the last reset
+
+    FrameArena(size_t size) : block(new char[size]), capacity(size), used(0), overflow(0) {}
+
+    void reset() {
+        if (overflow > 0) {
+            size_t grown = (capacity + overflow) * 2;
+            delete[] block;
+            block = new char[grown];
+            capacity = grown;
+        }
+        used = 0;
+        overflow = 0;
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + bytes <= capacity) {
+            used = start + bytes;
+            return block + start;
+        }
+        overflow += bytes + alignment;
+        return pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        // Arena memory is reclaimed all at once by reset()
+        if ((char*)p >= block && (char*)p < block + capacity) return;
+        pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+static FrameArena arena(256 * 1024);
+
+pmr::memory_resource* frameArena()
+{
+    return &arena;
+}
+
+void resetFrameArena()
+{
+    arena.reset();
+}
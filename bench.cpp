@@ -0,0 +1,114 @@
+#include "header.h"
+#include <time.h>
+
+// Headless benchmark: `./monitor --bench [frames]`.
+// Each iteration does the collector work of a worst-case frame (every window's
+// data plus a process scan, filter and sort) without creating a window, so the
+// numbers are comparable between hosts and builds.
+
+static double monotonicSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const int BENCH_WARMUP_FRAMES = 2; // arena growth and first-scan baselines
+
+int runBenchmark(int frames)
+{
+    vector<Proc> snapshot;
+    vector<int> rows;
+    ProcessOrder order;
+    ProcessTree tree;
+    ProcessFilter filter;
+    CmdlineIndex cmdlines;
+    filter.compile("", false);
+    order.setKeys({{PROC_COL_CPU, true}});
+
+    double total_time = 0.0;
+    double min_time = 1e9;
+    double max_time = 0.0;
+    long long steady_allocs = 0;
+    long long steady_bytes = 0;
+    char buf[64];
+    // Large fixed-size tables; kept off the stack
+    static DiskStatsReader diskReader;
+    static DiskStats diskStats;
+
+    initializeCPUMeasurements();
+    for (int frame = 0; frame < frames; frame++) {
+        double start = monotonicSeconds();
+        profileFrameBegin();
+        resetFrameArena();
+
+        CPUStats cpu = getCPUStats();
+        TaskSummary tasks = getTaskSummary();
+        double temp = getThermalTemp();
+        getFanStatus(buf, sizeof(buf));
+        MemoryInfo mem = getMemoryInfo();
+        MemoryInfo swap = getSwapInfo();
+        DiskInfo disk = getDiskInfo("/");
+        diskReader.update(diskStats, (uint64_t)(start * 1000.0));
+        pmr::vector<NetworkInterface> interfaces = getNetworkInterfaces(frameArena());
+
+        getProcesses(snapshot);
+        int task_counts[4];
+        countTaskStates(snapshot, task_counts);
+        filter.apply(snapshot, rows, cmdlines);
+        order.update(snapshot, rows);
+        order.ensureSorted(snapshot, 50);
+        tree.update(snapshot);
+        tree.buildRows(snapshot, rows, order.keys);
+
+        double elapsed = monotonicSeconds() - start;
+        ALLOC_FRAME_END();
+        profileFrameEnd();
+        (void)cpu; (void)temp; (void)mem; (void)swap; (void)disk;
+
+        if (frame < BENCH_WARMUP_FRAMES) continue;
+        total_time += elapsed;
+        min_time = min(min_time, elapsed);
+        max_time = max(max_time, elapsed);
+#ifdef MONITOR_TRACK_ALLOC
+        AllocStats stats = allocLastFrame();
+        steady_allocs += stats.allocs;
+        steady_bytes += stats.bytes;
+#endif
+        printf("frame %d: %.3f ms, %zu processes, %zu interfaces, %d threads\n",
+               frame, elapsed * 1000.0, snapshot.size(), interfaces.size(), tasks.threads);
+    }
+
+    int measured = frames - BENCH_WARMUP_FRAMES;
+    if (measured <= 0) {
+        printf("need more than %d frames\n", BENCH_WARMUP_FRAMES);
+        return 1;
+    }
+    printf("frame time: mean %.3f ms, min %.3f ms, max %.3f ms over %d frames\n",
+           total_time / measured * 1000.0, min_time * 1000.0, max_time * 1000.0, measured);
+
+    // The percentile window covers the warm-up frames too, which only matters for short runs
+    ProfileScopeStats stats[64];
+    int scopes_timed = profileScopeStats(stats, 64);
+    printf("%-28s %8s %8s %8s\n", "scope (ms)", "p50", "p95", "p99");
+    for (int i = 0; i < scopes_timed; i++) {
+        if (stats[i].samples == 0) continue;
+        printf("  %-26s %8.3f %8.3f %8.3f\n", stats[i].name, stats[i].p50, stats[i].p95, stats[i].p99);
+    }
+
+#ifdef MONITOR_TRACK_ALLOC
+    printf("allocations per frame: %.1f (%.0f bytes)\n",
+           (double)steady_allocs / measured, (double)steady_bytes / measured);
+    const AllocStats* scopes;
+    int count = allocLastScopes(&scopes);
+    printf("last frame by scope:\n");
+    for (int i = 0; i < count; i++) {
+        printf("  %-24s %6lld allocs %10lld bytes\n", scopes[i].name, scopes[i].allocs, scopes[i].bytes);
+    }
+#else
+    (void)steady_allocs;
+    (void)steady_bytes;
+    printf("allocation counts need a TRACK_ALLOC=1 build\n");
+#endif
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include "header.h"
+#include <algorithm>
+#include <fcntl.h>
+
+// cgroup v2 usage per container and service.
+// The directory tree is rescanned every WALK_INTERVAL_NS (or as soon as a cgroup
+// disappears); in between, a pass only rereads known cgroups. Each pass reads
+// cpu.stat and io.stat of every cgroup, and the rest (memory.current,
+// memory.stat, pids.current) only where usage_usec moved or the last read is
+// FULL_REFRESH_NS old. io.stat can't be skipped the same way: writeback and
+// reclaim are charged to a cgroup whose own tasks didn't run.
+// Processes are those of the last process scan, mapped through
+// /proc/<pid>/cgroup once per (pid, starttime) and again after each rescan,
+// since processes rarely move between cgroups.
+
+static const char* const cgroupRoots[] = {
+    "/sys/fs/cgroup",          // unified hierarchy
+    "/sys/fs/cgroup/unified",  // hybrid: v1 controllers with cgroup2 alongside
+};
+
+// "key value" line of a flat-keyed cgroup file; -1 if the key isn't there
+static long long keyedValue(const char* buf, const char* key)
+{
+    size_t key_len = strlen(key);
+    for (const char* line = buf; line && *line; line = strchr(line, '\n')) {
+        if (*line == '\n') line++;
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ') {
+            return strtoll(line + key_len + 1, nullptr, 10);
+        }
+    }
+    return -1;
+}
+
+// Reads a file of cgroup `path`; the length, or -1 if it doesn't exist
+static ssize_t readCgroupFile(int root_fd, const string& path, const char* file, char* buf, size_t size)
+{
+    char name[PATH_MAX];
+    if (path.empty()) {
+        snprintf(name, sizeof(name), "%s", file);
+    } else {
+        snprintf(name, sizeof(name), "%s/%s", path.c_str(), file);
+    }
+    return readProcFileAt(root_fd, name, buf, size);
+}
+
+CgroupMonitor::~CgroupMonitor()
+{
+    if (root_fd >= 0) close(root_fd);
+}
+
+void CgroupMonitor::walkDir(const string& path, const string& name, int depth, int parent, vector<Node>& out)
+{
+    // A cgroup seen before keeps its counters, so rates carry over the rescan
+    auto old = by_path.find(path);
+    if (old != by_path.end()) {
+        out.push_back(nodes[old->second]);
+    } else {
+        Node node;
+        node.info.path = path;
+        node.info.name = name;
+        node.info.tasks = -1;
+        node.info.memory = -1;
+        node.info.anon = node.info.file = 0;
+        node.info.cpu_usage = 0.0;
+        node.info.read_rate = node.info.write_rate = -1.0;
+        node.usage_usec = node.rbytes = node.wbytes = 0;
+        node.usage_ns = node.io_ns = node.full_ns = 0;
+        out.push_back(move(node));
+    }
+    int index = (int)out.size() - 1;
+    out[index].info.depth = depth;
+    out[index].info.parent = parent;
+    out[index].info.procs = 0;
+
+    vector<string> children;
+    int dir_fd = openat(root_fd, path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dir = dir_fd >= 0 ? fdopendir(dir_fd) : nullptr;
+    if (dir != nullptr) {
+        while (struct dirent* entry = readdir(dir)) {
+            if (entry->d_type == DT_DIR && entry->d_name[0] != '.') children.push_back(entry->d_name);
+        }
+        closedir(dir);
+    } else if (dir_fd >= 0) {
+        close(dir_fd);
+    }
+    sort(children.begin(), children.end());
+
+    for (const string& child : children) {
+        walkDir(path.empty() ? child : path + "/" + child, child, depth + 1, index, out);
+    }
+    out[index].info.subtree_end = (int)out.size();
+}
+
+void CgroupMonitor::walk()
+{
+    PROFILE_SCOPE("cgroup walk");
+    vector<Node> next;
+    next.reserve(nodes.size());
+    walkDir("", "/", 0, -1, next);
+    nodes.swap(next);
+
+    by_path.clear();
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        by_path[nodes[i].info.path] = i;
+    }
+}
+
+void CgroupMonitor::readNode(Node& node, uint64_t now)
+{
+    CgroupInfo& info = node.info;
+    char buf[4096];
+
+    // cpu.stat is in every cgroup, with or without the cpu controller
+    if (readCgroupFile(root_fd, info.path, "cpu.stat", buf, sizeof(buf)) <= 0) {
+        rewalk = true;
+        return;
+    }
+    unsigned long long usage = (unsigned long long)max(0LL, keyedValue(buf, "usage_usec"));
+    bool moved = usage != node.usage_usec;
+    if (node.usage_ns > 0 && now > node.usage_ns && usage >= node.usage_usec) {
+        info.cpu_usage = (usage - node.usage_usec) / ((now - node.usage_ns) / 1000.0) * 100.0;
+    }
+    node.usage_usec = usage;
+    node.usage_ns = now;
+
+    // "8:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0", one line per device
+    if (io_buf.empty()) io_buf.resize(4096);
+    ssize_t len;
+    while ((len = readCgroupFile(root_fd, info.path, "io.stat", io_buf.data(), io_buf.size())) >=
+           (ssize_t)io_buf.size() - 1) {
+        io_buf.resize(io_buf.size() * 2);
+    }
+    if (len >= 0) {
+        unsigned long long rbytes = 0, wbytes = 0;
+        for (const char* p = strstr(io_buf.data(), "rbytes="); p; p = strstr(p + 7, "rbytes=")) {
+            rbytes += strtoull(p + 7, nullptr, 10);
+        }
+        for (const char* p = strstr(io_buf.data(), "wbytes="); p; p = strstr(p + 7, "wbytes=")) {
+            wbytes += strtoull(p + 7, nullptr, 10);
+        }
+        if (node.io_ns > 0 && now > node.io_ns && rbytes >= node.rbytes && wbytes >= node.wbytes) {
+            double seconds = (now - node.io_ns) / 1e9;
+            info.read_rate = (rbytes - node.rbytes) / seconds;
+            info.write_rate = (wbytes - node.wbytes) / seconds;
+        } else {
+            info.read_rate = info.write_rate = 0.0;
+        }
+        node.rbytes = rbytes;
+        node.wbytes = wbytes;
+        node.io_ns = now;
+    } else {
+        info.read_rate = info.write_rate = -1.0;
+    }
+
+    if (!moved && node.full_ns > 0 && now - node.full_ns < FULL_REFRESH_NS) return;
+
+    info.memory = -1;
+    if (readCgroupFile(root_fd, info.path, "memory.current", buf, sizeof(buf)) > 0) {
+        info.memory = strtoll(buf, nullptr, 10);
+        if (readCgroupFile(root_fd, info.path, "memory.stat", buf, sizeof(buf)) > 0) {
+            info.anon = max(0LL, keyedValue(buf, "anon"));
+            info.file = max(0LL, keyedValue(buf, "file"));
+        }
+    }
+
+    info.tasks = -1;
+    if (readCgroupFile(root_fd, info.path, "pids.current", buf, sizeof(buf)) > 0) {
+        info.tasks = strtoll(buf, nullptr, 10);
+    }
+    node.full_ns = now;
+}
+
+void CgroupMonitor::mapProcesses(const vector<pair<int, long long>>& processes, bool reload)
+{
+    if (reload) pid_paths.clear();
+
+    // Merge the scan with the cache: known processes keep their path, new ones
+    // (including a reused pid) are read
+    vector<PidCgroup> next;
+    next.reserve(processes.size());
+    size_t known = 0;
+    for (const pair<int, long long>& proc : processes) {
+        while (known < pid_paths.size() && pid_paths[known].pid < proc.first) known++;
+        if (known < pid_paths.size() && pid_paths[known].pid == proc.first &&
+            pid_paths[known].starttime == proc.second) {
+            next.push_back(move(pid_paths[known]));
+            continue;
+        }
+
+        // "0::/system.slice/sshd.service" is the v2 line, next to any v1 ones
+        char path[32];
+        char buf[1024];
+        pidPath(path, proc.first, "cgroup");
+        if (readProcFileAt(procFd(), path, buf, sizeof(buf)) <= 0) continue;
+        const char* line = strncmp(buf, "0::", 3) == 0 ? buf : strstr(buf, "\n0::");
+        if (line == nullptr) continue;
+        line += *line == '\n' ? 4 : 3;
+        if (*line == '/') line++;
+        const char* end = strchr(line, '\n');
+        next.push_back({proc.first, proc.second, end ? string(line, end - line) : string(line)});
+    }
+    pid_paths.swap(next);
+
+    for (Node& node : nodes) node.info.procs = 0;
+    members.clear();
+    for (const PidCgroup& entry : pid_paths) {
+        // Processes of another cgroup namespace show paths outside ours; they are left out
+        auto it = by_path.find(entry.path);
+        if (it == by_path.end()) continue;
+        nodes[it->second].info.procs++;
+        members.emplace_back(entry.pid, it->second);
+    }
+}
+
+bool CgroupMonitor::update(const vector<pair<int, long long>>& processes)
+{
+    if (!tried) {
+        tried = true;
+        for (const char* candidate : cgroupRoots) {
+            char path[64];
+            snprintf(path, sizeof(path), "%s/cgroup.controllers", candidate);
+            if (access(path, F_OK) == 0) {
+                root = candidate;
+                root_fd = openDirFd(candidate);
+                break;
+            }
+        }
+    }
+    if (root_fd < 0) return false;
+
+    uint64_t now = profileNow();
+    bool walked = false;
+    if (nodes.empty() || rewalk || now - last_walk_ns >= WALK_INTERVAL_NS) {
+        walk();
+        last_walk_ns = now;
+        rewalk = false;
+        walked = true;
+    }
+    for (Node& node : nodes) {
+        readNode(node, now);
+    }
+    mapProcesses(processes, walked);
+    return true;
+}
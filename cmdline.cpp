@@ -0,0 +1,185 @@
+#include "header.h"
+#include <algorithm>
+#include <string.h>
+
+// Longer command lines (huge classpaths and the like) are truncated
+static const size_t MAX_CMDLINE = 8192;
+
+static uint32_t trigramAt(const char* p)
+{
+    return ((uint32_t)(unsigned char)tolower((unsigned char)p[0]) << 16) |
+           ((uint32_t)(unsigned char)tolower((unsigned char)p[1]) << 8) |
+           (uint32_t)(unsigned char)tolower((unsigned char)p[2]);
+}
+
+// Distinct trigrams of `text`, case-folded
+static void collectTrigrams(const string& text, vector<uint32_t>& out)
+{
+    out.clear();
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        out.push_back(trigramAt(text.data() + i));
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+// Read /proc/<pid>/cmdline with the NUL separators turned into spaces
+static string readCmdline(int pid)
+{
+    char path[32];
+    pidPath(path, pid, "cmdline");
+
+    string text;
+    char buf[MAX_CMDLINE];
+    ssize_t len = readProcFileAt(procFd(), path, buf, sizeof(buf));
+    if (len <= 0) return text;
+
+    while (len > 0 && buf[len - 1] == '\0') len--;
+    for (ssize_t i = 0; i < len; i++) {
+        if (buf[i] == '\0') buf[i] = ' ';
+    }
+    text.assign(buf, len);
+    return text;
+}
+
+void CmdlineIndex::addDoc(int pid, long long starttime)
+{
+    uint32_t id = (uint32_t)docs.size();
+    docs.push_back({pid, starttime, true, readCmdline(pid)});
+    by_pid[pid] = id;
+
+    // New ids are always the largest so far, so appending keeps every list sorted
+    static vector<uint32_t> trigrams;
+    collectTrigrams(docs.back().text, trigrams);
+    for (uint32_t t : trigrams) {
+        postings[t].push_back(id);
+    }
+}
+
+// Removal only marks the document dead; its ids are dropped from the posting
+// lists in bulk by compact()
+void CmdlineIndex::removeDoc(uint32_t id)
+{
+    docs[id].alive = false;
+    docs[id].text.clear();
+    docs[id].text.shrink_to_fit();
+    dead_count++;
+}
+
+// Renumber live documents densely and rewrite the posting lists without dead ids
+void CmdlineIndex::compact()
+{
+    vector<uint32_t> remap(docs.size(), UINT32_MAX);
+    vector<Doc> live;
+    live.reserve(docs.size() - dead_count);
+    for (uint32_t id = 0; id < docs.size(); id++) {
+        if (docs[id].alive) {
+            remap[id] = (uint32_t)live.size();
+            live.push_back(std::move(docs[id]));
+        }
+    }
+    docs.swap(live);
+
+    for (auto it = postings.begin(); it != postings.end();) {
+        vector<uint32_t>& list = it->second;
+        size_t out = 0;
+        for (uint32_t id : list) {
+            if (remap[id] != UINT32_MAX) list[out++] = remap[id];
+        }
+        list.resize(out);
+        if (list.empty()) {
+            it = postings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto& entry : by_pid) {
+        entry.second = remap[entry.second];
+    }
+    dead_count = 0;
+}
+
+// Bring the index in line with the (pid, starttime) keys of a scan, sorted by
+// pid: exited processes are dropped, new ones (or reused pids with a different
+// starttime) are read and indexed. Each sync costs in proportion to the process
+// churn, not the process count.
+void CmdlineIndex::sync(const vector<pair<int, long long>>& keys)
+{
+    ALLOC_SCOPE("CmdlineIndex::sync");
+    PROFILE_SCOPE("CmdlineIndex::sync");
+    for (auto it = by_pid.begin(); it != by_pid.end();) {
+        auto cur = lower_bound(keys.begin(), keys.end(), make_pair(it->first, LLONG_MIN));
+        if (cur == keys.end() || cur->first != it->first || cur->second != docs[it->second].starttime) {
+            removeDoc(it->second);
+            it = by_pid.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (const pair<int, long long>& key : keys) {
+        if (!by_pid.count(key.first)) {
+            addDoc(key.first, key.second);
+        }
+    }
+
+    if (dead_count > docs.size() / 2) {
+        compact();
+    }
+}
+
+// True if the index already holds exactly the processes of `keys`
+bool CmdlineIndex::matches(const vector<pair<int, long long>>& keys) const
+{
+    if (keys.size() != by_pid.size()) return false;
+    for (const pair<int, long long>& key : keys) {
+        auto it = by_pid.find(key.first);
+        if (it == by_pid.end() || docs[it->second].starttime != key.second) return false;
+    }
+    return true;
+}
+
+void CmdlineIndex::search(const string& needle, bool icase, pmr::vector<int>& pids) const
+{
+    pids.clear();
+
+    // Too short to have a trigram: check every document
+    if (needle.size() < 3) {
+        for (const Doc& doc : docs) {
+            if (doc.alive && containsText(doc.text.data(), doc.text.size(), needle, icase)) {
+                pids.push_back(doc.pid);
+            }
+        }
+        sort(pids.begin(), pids.end());
+        return;
+    }
+
+    static vector<uint32_t> trigrams;
+    collectTrigrams(needle, trigrams);
+
+    pmr::vector<const vector<uint32_t>*> lists(frameArena());
+    for (uint32_t t : trigrams) {
+        auto it = postings.find(t);
+        if (it == postings.end()) return; // some trigram occurs nowhere
+        lists.push_back(&it->second);
+    }
+    sort(lists.begin(), lists.end(), [](const vector<uint32_t>* a, const vector<uint32_t>* b) {
+        return a->size() < b->size();
+    });
+
+    // Walk the shortest list and probe the others, then confirm the real substring
+    for (uint32_t id : *lists[0]) {
+        bool in_all = true;
+        for (size_t i = 1; i < lists.size() && in_all; i++) {
+            in_all = binary_search(lists[i]->begin(), lists[i]->end(), id);
+        }
+        if (!in_all) continue;
+
+        const Doc& doc = docs[id];
+        if (doc.alive && containsText(doc.text.data(), doc.text.size(), needle, icase)) {
+            pids.push_back(doc.pid);
+        }
+    }
+    sort(pids.begin(), pids.end());
+}
@@ -0,0 +1,170 @@
+#include "header.h"
+#include <fcntl.h>
+
+// Block device throughput and latency from /proc/diskstats.
+// The file stays open and is reread with pread() into a fixed buffer; lines are
+// parsed in place into a fixed device table, so a sample costs one syscall and
+// no allocations however often it runs. Rates are deltas between two samples.
+
+static const int SECTOR_SIZE = 512; // diskstats always counts 512-byte sectors
+
+static unsigned long long parseCounter(const char*& p)
+{
+    while (*p == ' ') p++;
+    unsigned long long value = 0;
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return value;
+}
+
+static void pushHistory(DiskDevice& dev)
+{
+    dev.util_history[dev.history_pos] = (float)dev.utilization;
+    dev.bytes_history[dev.history_pos] = (float)(dev.read_rate + dev.write_rate);
+    dev.await_history[dev.history_pos] = (float)dev.await_ms;
+    dev.history_pos = (dev.history_pos + 1) % DISK_HISTORY;
+    if (dev.history_len < DISK_HISTORY) dev.history_len++;
+}
+
+DiskStatsReader::~DiskStatsReader()
+{
+    if (fd >= 0) close(fd);
+}
+
+// Only whole disks are shown: partitions would count the same requests twice,
+// and loop and ram devices are mostly idle noise (a snap host has dozens)
+bool DiskStatsReader::skip(const char* name)
+{
+    for (int i = 0; i < skipped_count; i++) {
+        if (strcmp(skipped[i], name) == 0) return true;
+    }
+
+    bool skip = strncmp(name, "loop", 4) == 0 || strncmp(name, "ram", 3) == 0;
+    if (!skip) {
+        // Whole disks have a /sys/block entry, with '/' in the name spelled '!'
+        char path[64] = "/sys/block/";
+        size_t len = strlen(path);
+        for (const char* p = name; *p && len < sizeof(path) - 1; p++) {
+            path[len++] = *p == '/' ? '!' : *p;
+        }
+        path[len] = '\0';
+        skip = access(path, F_OK) != 0;
+    }
+    if (skip && skipped_count < MAX_SKIPPED) {
+        strcpy(skipped[skipped_count++], name);
+    }
+    return skip;
+}
+
+bool DiskStatsReader::update(DiskStats& stats, uint64_t now_ms)
+{
+    PROFILE_SCOPE("diskstats");
+    if (fd < 0) {
+        fd = open("/proc/diskstats", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+    }
+
+    size_t len = 0;
+    while (len < sizeof(buf) - 1) {
+        ssize_t n = pread(fd, buf + len, sizeof(buf) - 1 - len, len);
+        if (n <= 0) break;
+        len += n;
+    }
+    if (len == 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    buf[len] = '\0';
+
+    double seconds = last_ms > 0 && now_ms > last_ms ? (now_ms - last_ms) / 1000.0 : 0.0;
+    last_ms = now_ms;
+
+    bool seen[MAX_DISKS] = {};
+    const char* p = buf;
+    while (*p) {
+        // "major minor name" then the counters
+        parseCounter(p);
+        parseCounter(p);
+        while (*p == ' ') p++;
+        char name[DISK_NAME_MAX];
+        size_t name_len = 0;
+        while (*p && *p != ' ' && *p != '\n') {
+            if (name_len < sizeof(name) - 1) name[name_len++] = *p;
+            p++;
+        }
+        name[name_len] = '\0';
+
+        int index = -1;
+        for (int i = 0; i < stats.count; i++) {
+            if (strcmp(stats.devices[i].name, name) == 0) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0 && name_len > 0 && !skip(name) && stats.count < MAX_DISKS) {
+            index = stats.count++;
+            DiskDevice& dev = stats.devices[index];
+            memset(&dev, 0, sizeof(dev));
+            strcpy(dev.name, name);
+        }
+
+        if (index >= 0) {
+            DiskDevice& dev = stats.devices[index];
+            seen[index] = true;
+
+            unsigned long long reads = parseCounter(p);
+            parseCounter(p); // reads merged
+            unsigned long long read_sectors = parseCounter(p);
+            unsigned long long read_ms = parseCounter(p);
+            unsigned long long writes = parseCounter(p);
+            parseCounter(p); // writes merged
+            unsigned long long write_sectors = parseCounter(p);
+            unsigned long long write_ms = parseCounter(p);
+            unsigned long long in_flight = parseCounter(p);
+            unsigned long long io_ticks = parseCounter(p);
+
+            // A counter going backwards means the device was replaced under the same name
+            bool valid = dev.has_prev && seconds > 0.0 && reads >= dev.reads && writes >= dev.writes &&
+                         read_sectors >= dev.read_sectors && write_sectors >= dev.write_sectors &&
+                         read_ms >= dev.read_ms && write_ms >= dev.write_ms && io_ticks >= dev.io_ticks;
+            if (valid) {
+                unsigned long long requests = (reads - dev.reads) + (writes - dev.writes);
+                unsigned long long busy_ms = (read_ms - dev.read_ms) + (write_ms - dev.write_ms);
+                dev.read_iops = (reads - dev.reads) / seconds;
+                dev.write_iops = (writes - dev.writes) / seconds;
+                dev.read_rate = (double)(read_sectors - dev.read_sectors) * SECTOR_SIZE / seconds;
+                dev.write_rate = (double)(write_sectors - dev.write_sectors) * SECTOR_SIZE / seconds;
+                dev.await_ms = requests > 0 ? (double)busy_ms / requests : 0.0;
+                dev.utilization = min(100.0, (io_ticks - dev.io_ticks) / (seconds * 10.0));
+                pushHistory(dev);
+            }
+
+            dev.reads = reads;
+            dev.read_sectors = read_sectors;
+            dev.read_ms = read_ms;
+            dev.writes = writes;
+            dev.write_sectors = write_sectors;
+            dev.write_ms = write_ms;
+            dev.in_flight = in_flight;
+            dev.io_ticks = io_ticks;
+            dev.has_prev = true;
+        }
+
+        // Newer kernels append discard and flush counters; they aren't used
+        while (*p && *p != '\n') p++;
+        if (*p == '\n') p++;
+    }
+
+    // Drop devices that went away, keeping the rest in diskstats order
+    int kept = 0;
+    for (int i = 0; i < stats.count; i++) {
+        if (!seen[i]) continue;
+        if (kept != i) stats.devices[kept] = stats.devices[i];
+        kept++;
+    }
+    stats.count = kept;
+    return true;
+}
@@ -0,0 +1,94 @@
+#include "header.h"
+#include <charconv>
+#include <string.h>
+
+// Append `text` at `p`, never writing past `end`
+static void appendText(char*& p, char* end, const char* text)
+{
+    while (*text && p < end) {
+        *p++ = *text++;
+    }
+}
+
+static void appendInt(char*& p, char* end, long long value)
+{
+    to_chars_result r = to_chars(p, end, value);
+    if (r.ec == errc()) p = r.ptr;
+}
+
+static void appendFixed(char*& p, char* end, double value, int precision)
+{
+    to_chars_result r = to_chars(p, end, value, chars_format::fixed, precision);
+    if (r.ec == errc()) p = r.ptr;
+}
+
+// Format bytes to appropriate unit (B, KB, MB, GB, TB) with two decimals
+const char* formatBytes(char* buf, size_t size, long long bytes)
+{
+    static const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    int unit_index = 0;
+    double value = (double)bytes;
+
+    while (value >= 1024.0 && unit_index < 4) {
+        value /= 1024.0;
+        unit_index++;
+    }
+
+    char* p = buf;
+    char* end = buf + size - 1;
+    if (unit_index == 0) {
+        appendInt(p, end, (long long)value);
+    } else {
+        appendFixed(p, end, value, 2);
+    }
+    appendText(p, end, " ");
+    appendText(p, end, units[unit_index]);
+    *p = '\0';
+    return buf;
+}
+
+// Format bytes rounded to a whole number of the largest fitting unit
+const char* formatMemoryBytes(char* buf, size_t size, long long bytes)
+{
+    char* p = buf;
+    char* end = buf + size - 1;
+
+    if (bytes >= 1024LL * 1024 * 1024) {
+        appendInt(p, end, (long long)round((double)bytes / (1024.0 * 1024.0 * 1024.0)));
+        appendText(p, end, " GB");
+    } else if (bytes >= 1024 * 1024) {
+        appendInt(p, end, (long long)round((double)bytes / (1024.0 * 1024.0)));
+        appendText(p, end, " MB");
+    } else if (bytes >= 1024) {
+        appendInt(p, end, (long long)round((double)bytes / 1024.0));
+        appendText(p, end, " KB");
+    } else {
+        appendInt(p, end, bytes);
+        appendText(p, end, " B");
+    }
+    *p = '\0';
+    return buf;
+}
+
+// "<used> / <total> (<percentage>%)" for the usage progress bars
+const char* formatUsage(char* buf, size_t size, long long used, long long total, double percentage)
+{
+    char part[32];
+    char* p = buf;
+    char* end = buf + size - 1;
+
+    appendText(p, end, formatMemoryBytes(part, sizeof(part), used));
+    appendText(p, end, " / ");
+    appendText(p, end, formatMemoryBytes(part, sizeof(part), total));
+    appendText(p, end, " (");
+    appendInt(p, end, (long long)percentage);
+    appendText(p, end, "%)");
+    *p = '\0';
+    return buf;
+}
+
+string formatBytes(long long bytes)
+{
+    char buf[32];
+    return string(formatBytes(buf, sizeof(buf), bytes));
+}
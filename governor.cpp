@@ -0,0 +1,152 @@
+#include "header.h"
+#include <sched.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// Overhead governor: collectors that are expensive on big or busy hosts run
+// through due()/GovernorRun, which measure the CPU time each run takes. Every
+// GOVERNOR_WINDOW seconds adjust() compares the total against the budget and
+// halves the rate of the most expensive collector, or doubles the rate of the
+// cheapest slowed-down one once there is room again.
+// Shares are the smoothed cost per run over the current interval, not CPU time
+// counted within the window: a slowed collector runs every 32 s at most, and a
+// 2 s window would see it alternately as free and as far over budget.
+
+static const double GOVERNOR_WINDOW = 2.0;
+static const int MAX_SLOWDOWN = 16;
+
+double threadCpuSeconds()
+{
+    // CPU time of the calling thread only, so other threads running meanwhile aren't counted
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Governor::Governor() : enabled(true), cpu_budget(1.0f), idle_priority(false),
+                       window_start(0.0), collection_cpu(0.0)
+{
+    static const char* names[GOV_COUNT] = {"Processes", "Task counts", "Command lines", "Sensors", "cgroups"};
+    static const double intervals[GOV_COUNT] = {2.0, 0.25, 2.0, 0.2, 2.0};
+    for (int i = 0; i < GOV_COUNT; i++) {
+        GovernedCollector& c = collectors[i];
+        c.name = names[i];
+        c.base_interval = intervals[i];
+        c.interval = intervals[i];
+        c.slowdown = 1;
+        c.last_run = -1.0;
+        c.cost_ms = 0.0;
+        c.cpu_share = 0.0;
+    }
+}
+
+bool Governor::due(int id, double now) const
+{
+    lock_guard<mutex> guard(lock);
+    const GovernedCollector& c = collectors[id];
+    return c.last_run < 0.0 || now - c.last_run >= c.interval;
+}
+
+double Governor::nextDue(int id) const
+{
+    lock_guard<mutex> guard(lock);
+    const GovernedCollector& c = collectors[id];
+    return c.last_run < 0.0 ? 0.0 : c.last_run + c.interval;
+}
+
+double Governor::interval(int id) const
+{
+    lock_guard<mutex> guard(lock);
+    return collectors[id].interval;
+}
+
+void Governor::record(int id, double now, double cpu_seconds)
+{
+    lock_guard<mutex> guard(lock);
+    GovernedCollector& c = collectors[id];
+    c.last_run = now;
+    // Smoothed so a single slow run (page cache miss, a fork storm) doesn't dominate
+    double ms = cpu_seconds * 1000.0;
+    c.cost_ms = c.cost_ms == 0.0 ? ms : c.cost_ms * 0.8 + ms * 0.2;
+}
+
+void Governor::adjust(double now)
+{
+    lock_guard<mutex> guard(lock);
+    if (window_start == 0.0) {
+        window_start = now;
+        return;
+    }
+    double elapsed = now - window_start;
+    if (elapsed < GOVERNOR_WINDOW) return;
+
+    collection_cpu = 0.0;
+    for (GovernedCollector& c : collectors) {
+        // A collector nobody asked for lately (cmd~ filters, the cgroups tab) costs nothing
+        bool active = c.last_run >= 0.0 && now - c.last_run < 2.0 * c.interval + GOVERNOR_WINDOW;
+        c.cpu_share = active ? c.cost_ms / 10.0 / c.interval : 0.0;
+        collection_cpu += c.cpu_share;
+    }
+    window_start = now;
+
+    if (!enabled) {
+        for (GovernedCollector& c : collectors) {
+            c.slowdown = 1;
+            c.interval = c.base_interval;
+        }
+        return;
+    }
+
+    // One step per window, so the effect of each change is measured before the next
+    if (collection_cpu > cpu_budget) {
+        GovernedCollector* worst = nullptr;
+        for (GovernedCollector& c : collectors) {
+            if (c.slowdown < MAX_SLOWDOWN && (worst == nullptr || c.cpu_share > worst->cpu_share)) {
+                worst = &c;
+            }
+        }
+        if (worst != nullptr && worst->cpu_share > 0.0) {
+            worst->slowdown *= 2;
+            worst->interval = worst->base_interval * worst->slowdown;
+        }
+    } else if (collection_cpu < cpu_budget * 0.5) {
+        // Speeding a collector up doubles its share; only do it if that still fits
+        GovernedCollector* cheapest = nullptr;
+        for (GovernedCollector& c : collectors) {
+            if (c.slowdown > 1 && (cheapest == nullptr || c.cpu_share < cheapest->cpu_share)) {
+                cheapest = &c;
+            }
+        }
+        if (cheapest != nullptr && collection_cpu + cheapest->cpu_share < cpu_budget * 0.8) {
+            cheapest->slowdown /= 2;
+            cheapest->interval = cheapest->base_interval * cheapest->slowdown;
+        }
+    }
+}
+
+bool Governor::applyIdlePriority(bool on)
+{
+    // With tid 0 these apply to the calling thread only, i.e. the sampler
+    struct sched_param param = {0};
+    if (on) {
+        if (sched_setscheduler(0, SCHED_IDLE, &param) != 0 &&
+            setpriority(PRIO_PROCESS, 0, 19) != 0) {
+            return false;
+        }
+    } else {
+        // Leaving SCHED_IDLE is allowed unprivileged; undoing a nice value may not be
+        if (sched_setscheduler(0, SCHED_OTHER, &param) != 0) return false;
+        setpriority(PRIO_PROCESS, 0, 0);
+    }
+    return true;
+}
+
+GovernorRun::GovernorRun(Governor& governor, int id, double now)
+    : governor(governor), id(id), now(now), cpu_start(threadCpuSeconds()), worker_cpu(0.0)
+{
+}
+
+GovernorRun::~GovernorRun()
+{
+    governor.record(id, now, threadCpuSeconds() - cpu_start + worker_cpu);
+}
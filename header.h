@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include <dirent.h>
 #include <vector>
+#include <memory>
+#include <memory_resource>
 #include <iostream>
 #include <cmath>
 // lib to read from file
@@ -23,6 +25,7 @@
 // this is for the memory usage and other memory visualization
 // for linux gotta find a way for windows
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/sysinfo.h>
 #include <sys/statvfs.h>
 // for time and date
@@ -33,6 +36,13 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <map>
+#include <string.h>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
 
 using namespace std;
 
@@ -54,12 +64,26 @@ struct CPUStats
 struct Proc
 {
     int pid;
+    int ppid;
     string name;
     char state;
+    int num_threads;
     long long int vsize;
     long long int rss;
     long long int utime;
     long long int stime;
+    long long int starttime; // clock ticks after boot; tells a reused pid apart
+    uid_t uid;
+    double cpu_usage;     // % of total CPU time since the previous scan
+    double mem_usage;     // % of physical memory (rss)
+    bool has_io;          // /proc/<pid>/io was readable
+    long long read_bytes; // storage I/O totals and read/write syscalls from /proc/<pid>/io
+    long long write_bytes;
+    long long syscr;
+    long long syscw;
+    double read_rate;     // bytes/s since the previous scan
+    double write_rate;
+    double syscall_rate;  // read + write syscalls/s
 };
 
 struct IP4
@@ -97,6 +121,13 @@ struct RX
     int compressed;
 };
 
+// Thread counts the kernel keeps for /proc/stat and /proc/loadavg
+struct TaskSummary {
+    int running;   // runnable threads (procs_running)
+    int blocked;   // threads waiting on I/O (procs_blocked)
+    int threads;   // all threads
+};
+
 // Core system information functions
 string CPUinfo();
 const char *getOsName();
@@ -104,10 +135,115 @@ string getHostname();
 string getLoggedUser();
 CPUStats getCPUStats();
 double calculateCPUUsage(const CPUStats& prev, const CPUStats& curr);
-vector<int> getTaskCounts(); // [running, sleeping, stopped, zombie]
+TaskSummary getTaskSummary();
 double getThermalTemp();
-string getFanStatus();
+const char* getFanStatus(char* buf, size_t size);
 int getFanSpeed();
+ssize_t readProcFile(const char* path, char* buf, size_t size);
+ssize_t readProcFileAt(int dir_fd, const char* path, char* buf, size_t size);
+int openDirFd(const char* path);
+int procFd();
+// Rewinds `dir_fd` and lists its all-digit entries (pids, tids) with getdents64
+bool listNumericEntries(int dir_fd, vector<int>& ids);
+// Writes "<pid>/<file>" (or just "<pid>") into `out`, at least 32 bytes; returns the length
+int pidPath(char* out, int pid, const char* file);
+
+// Per-frame arena (arena.cpp).
+// Temporaries built on frameArena() are bump-allocated and all released together
+// by resetFrameArena() at the start of the next frame, so they must not outlive it.
+pmr::memory_resource* frameArena();
+void resetFrameArena();
+
+// Allocation tracking (alloctrack.cpp), built with `make TRACK_ALLOC=1`.
+// ALLOC_SCOPE("name") counts the heap allocations made on this thread until the
+// end of the enclosing block; allocFrameEnd() publishes the per-frame numbers.
+// In normal builds the macros expand to nothing and operator new is untouched.
+struct AllocStats {
+    const char* name;
+    long long allocs;
+    long long bytes;
+};
+
+struct AllocTotals {
+    long long allocs;
+    long long frees;
+    long long bytes;       // requested since startup
+    long long live_bytes;  // usable size of blocks not yet freed
+};
+
+#define SCOPE_CONCAT_(a, b) a##b
+#define SCOPE_CONCAT(a, b) SCOPE_CONCAT_(a, b)
+
+#ifdef MONITOR_TRACK_ALLOC
+struct AllocScope {
+    int slot;
+    long long allocs;
+    long long bytes;
+    AllocScope(int slot);
+    ~AllocScope();
+};
+
+int allocScopeSlot(const char* name);
+void allocFrameEnd();
+AllocStats allocLastFrame();
+int allocLastScopes(const AllocStats** scopes);
+AllocTotals allocTotals();
+
+#define ALLOC_SCOPE(name) \
+    static const int SCOPE_CONCAT(allocSlot_, __LINE__) = allocScopeSlot(name); \
+    AllocScope SCOPE_CONCAT(allocScope_, __LINE__)(SCOPE_CONCAT(allocSlot_, __LINE__))
+#define ALLOC_FRAME_END() allocFrameEnd()
+#else
+#define ALLOC_SCOPE(name) ((void)0)
+#define ALLOC_FRAME_END() ((void)0)
+#endif
+
+// Scope timers (profiler.cpp).
+// PROFILE_SCOPE("name") records the wall time of the enclosing block into a
+// per-thread ring; profileFrameEnd() collects the rings once per frame for the
+// profiler overlay: the last frame's timeline and rolling p50/p95/p99 per scope.
+const int MAX_PROFILE_THREADS = 16;  // threads with a ring; later ones aren't timed
+
+struct ProfileEvent {
+    int scope;
+    int thread;     // ring index, 0..MAX_PROFILE_THREADS-1
+    int depth;      // nesting level on its thread, 0 = outermost
+    uint64_t start; // profileNow() nanoseconds
+    uint64_t end;
+};
+
+struct ProfileScopeStats {
+    const char* name;
+    float last_ms;  // total over the last frame
+    int last_calls;
+    int samples;    // frames in the percentile window
+    float p50;
+    float p95;
+    float p99;
+};
+
+struct ProfileScope {
+    int slot;
+    uint64_t start;
+    ProfileScope(int slot);
+    ~ProfileScope();
+};
+
+uint64_t profileNow();
+int profileScopeSlot(const char* name);
+void profileFrameBegin();
+void profileFrameEnd();
+int profileScopeStats(ProfileScopeStats* out, int max_out);
+int profileFrameEvents(const ProfileEvent** events, uint64_t* start, uint64_t* end);
+const char* profileScopeName(int slot);
+
+#define PROFILE_SCOPE(name) \
+    static const int SCOPE_CONCAT(profileSlot_, __LINE__) = profileScopeSlot(name); \
+    ProfileScope SCOPE_CONCAT(profileScope_, __LINE__)(SCOPE_CONCAT(profileSlot_, __LINE__))
+
+// Headless benchmark (bench.cpp): runs the per-frame collectors `frames` times
+// and prints timings (and allocations when tracking is built in)
+int runBenchmark(int frames);
 
 // UI state management for graphs
 struct GraphData {
@@ -118,7 +254,7 @@ struct GraphData {
     float y_scale;
     double last_update_time;
 
-    GraphData(int max = 100) : max_values(max), animate(true), fps(60.0f), y_scale(100.0f), last_update_time(0.0) {}
+    GraphData(int max = 100) : max_values(max), animate(true), fps(10.0f), y_scale(100.0f), last_update_time(0.0) {}
 
     bool shouldUpdate() {
         double current_time = SDL_GetTicks() / 1000.0; // Get time in seconds
@@ -137,6 +273,16 @@ struct GraphData {
             values.erase(values.begin());
         }
     }
+
+    // A sample that covers `elapsed` seconds fills as many points as frames at
+    // `fps` would have, so a slowed-down source still scrolls at the usual speed
+    void addSample(float value, double elapsed) {
+        int points = (int)(elapsed * fps + 0.5);
+        points = min(max(points, 1), max_values);
+        for (int i = 0; i < points; i++) {
+            addValue(value);
+        }
+    }
 };
 
 // Memory and process monitoring functions
@@ -157,11 +303,473 @@ struct DiskInfo {
 MemoryInfo getMemoryInfo();
 MemoryInfo getSwapInfo();
 DiskInfo getDiskInfo(const string& path = "/");
+
+// Block device activity from /proc/diskstats (disk.cpp).
+// Everything is fixed-size, so a refresh neither allocates nor frees.
+static const int MAX_DISKS = 32;
+static const int DISK_HISTORY = 120;   // samples kept for the graphs
+static const size_t DISK_NAME_MAX = 32;
+
+struct DiskDevice {
+    char name[DISK_NAME_MAX];
+    // Counters as of the last sample
+    unsigned long long reads;          // completed
+    unsigned long long read_sectors;   // 512-byte sectors, whatever the device's block size
+    unsigned long long read_ms;        // time spent by all reads
+    unsigned long long writes;
+    unsigned long long write_sectors;
+    unsigned long long write_ms;
+    unsigned long long io_ticks;       // ms with at least one request in flight
+    unsigned long long in_flight;
+    bool has_prev;
+    // Rates over the last interval
+    double read_iops;
+    double write_iops;
+    double read_rate;                  // bytes/s
+    double write_rate;
+    double await_ms;                   // average time per completed request, queueing included
+    double utilization;                // % of the interval the device was busy
+    // Rings; `history_pos` is the oldest entry once `history_len` reaches DISK_HISTORY
+    float util_history[DISK_HISTORY];
+    float bytes_history[DISK_HISTORY]; // read + write bytes/s
+    float await_history[DISK_HISTORY];
+    int history_pos;
+    int history_len;
+};
+
+struct DiskStats {
+    int count;
+    DiskDevice devices[MAX_DISKS];
+
+    DiskStats() : count(0) {}
+};
+
+// Keeps /proc/diskstats open and rereads it in place; sampler thread only
+struct DiskStatsReader {
+    static const int MAX_SKIPPED = 256;
+
+    int fd;
+    uint64_t last_ms;
+    char buf[65536];
+    // Partitions, loop and ram devices seen so far, so each is only checked once
+    char skipped[MAX_SKIPPED][DISK_NAME_MAX];
+    int skipped_count;
+
+    DiskStatsReader() : fd(-1), last_ms(0), skipped_count(0) {}
+    ~DiskStatsReader();
+    // Folds a new sample into `stats`; false if /proc/diskstats can't be read
+    bool update(DiskStats& stats, uint64_t now_ms);
+    bool skip(const char* name);
+};
+
+// Pressure stall information from /proc/pressure (pressure.cpp)
+enum PressureResource { PRESSURE_CPU, PRESSURE_MEMORY, PRESSURE_IO, PRESSURE_COUNT };
+
+static const int PRESSURE_HISTORY = 240;
+
+struct PressureLine {
+    double avg10;                // % of time stalled, kernel running averages
+    double avg60;
+    double avg300;
+    unsigned long long total;    // µs stalled since boot
+    double rate;                 // % of time stalled over the last interval, from `total`
+};
+
+struct PressureResourceStats {
+    bool available;              // false without CONFIG_PSI, with psi=0, or for a missing file
+    bool has_prev;
+    PressureLine some;           // at least one task stalled
+    PressureLine full;           // all non-idle tasks stalled at once
+    float some_history[PRESSURE_HISTORY];
+    float full_history[PRESSURE_HISTORY];
+    int history_pos;             // oldest entry once history_len reaches PRESSURE_HISTORY
+    int history_len;
+};
+
+struct PressureStats {
+    PressureResourceStats resources[PRESSURE_COUNT];
+
+    PressureStats() { memset(resources, 0, sizeof(resources)); }
+};
+
+// Keeps the three pressure files open and rereads them in place; sampler thread only
+struct PressureReader {
+    int fds[PRESSURE_COUNT];
+    bool opened;
+    uint64_t last_ns;
+
+    PressureReader() : opened(false), last_ns(0) {
+        for (int& fd : fds) fd = -1;
+    }
+    ~PressureReader();
+    // false if no pressure file can be read at all
+    bool update(PressureStats& stats);
+};
+
+// cgroup v2 hierarchy with per-cgroup usage (cgroups.cpp).
+// cgroup v2 counters already include all descendants, so every row is the cost
+// of its whole subtree without adding anything up.
+struct CgroupInfo {
+    string path;           // relative to the cgroup root, "" for the root itself
+    string name;           // last path component
+    int depth;
+    int parent;            // index of the parent row, -1 for the root
+    int subtree_end;       // index just past the last descendant
+    int procs;             // processes directly in this cgroup
+    long long tasks;       // pids.current, -1 without the pids controller
+    long long memory;      // memory.current in bytes, -1 without the memory controller
+    long long anon;        // from memory.stat
+    long long file;        // page cache
+    double cpu_usage;      // % of one core since the previous pass
+    double read_rate;      // bytes/s from io.stat, -1 without the io controller
+    double write_rate;
+};
+
+struct CgroupMonitor {
+    static constexpr uint64_t WALK_INTERVAL_NS = 10000000000ull;  // directory rescan
+    static constexpr uint64_t FULL_REFRESH_NS = 10000000000ull;   // memory/pids of idle cgroups
+
+    struct Node {
+        CgroupInfo info;
+        unsigned long long usage_usec;  // cpu.stat
+        unsigned long long rbytes;      // io.stat, all devices
+        unsigned long long wbytes;
+        uint64_t usage_ns;              // when usage_usec was read
+        uint64_t io_ns;                 // when io.stat was read, 0 = never
+        uint64_t full_ns;               // when the other files were last read, 0 = never
+    };
+
+    // Cgroup of one process, read once per (pid, starttime)
+    struct PidCgroup {
+        int pid;
+        long long starttime;
+        string path;
+    };
+
+    string root;            // where cgroup2 is mounted; empty if it isn't
+    int root_fd;
+    bool tried;
+    bool rewalk;            // set when a cgroup vanished between walks
+    uint64_t last_walk_ns;
+    vector<Node> nodes;     // depth first, siblings by name
+    unordered_map<string, int> by_path;
+    vector<pair<int, int>> members;      // (pid, node index), by pid
+    vector<PidCgroup> pid_paths;         // by pid
+    vector<char> io_buf;                 // io.stat has a line per block device
+
+    CgroupMonitor() : root_fd(-1), tried(false), rewalk(false), last_walk_ns(0) {}
+    ~CgroupMonitor();
+    // One pass over the processes of the last scan; false if there is no cgroup2 hierarchy
+    bool update(const vector<pair<int, long long>>& processes);
+    void walk();
+    void walkDir(const string& path, const string& name, int depth, int parent, vector<Node>& out);
+    void readNode(Node& node, uint64_t now);
+    void mapProcesses(const vector<pair<int, long long>>& processes, bool reload);
+};
+
+// Usage of every mounted filesystem (mounts.cpp).
+// Mounts come from /proc/self/mountinfo; statvfs() runs on a worker thread so a
+// hung network mount is reported as such instead of stalling the sampler.
+enum FilesystemState {
+    FS_PENDING,          // not measured yet
+    FS_OK,
+    FS_HUNG,             // statvfs() didn't return within the timeout; still waiting for it
+    FS_ERROR             // statvfs() failed
+};
+
+struct FilesystemInfo {
+    int mount_id;
+    string mount_point;
+    string source;
+    string fstype;
+    int state;           // FilesystemState
+    long long total;     // bytes
+    long long used;
+    long long available; // to unprivileged users, as df shows it
+    double percentage;
+    long long inodes_total; // 0 if the filesystem has no fixed inode count (btrfs, some network fs)
+    long long inodes_used;
+    double inodes_percentage;
+};
+
+// One statvfs() call, shared with the worker thread that makes it
+struct StatvfsProbe {
+    string path;
+    atomic<uint64_t> started_ms; // when the worker picked it up, 0 while queued
+    atomic<bool> done;
+    bool ok;                     // written before `done`
+    struct statvfs result;
+
+    StatvfsProbe(const string& path) : path(path), started_ms(0), done(false), ok(false) {}
+};
+
+// Runs probes one after another. A worker stuck in a probe past the timeout is
+// abandoned (it exits once the call returns) and a fresh one takes the queue.
+struct StatvfsWorker {
+    mutex lock;
+    condition_variable cv;
+    vector<shared_ptr<StatvfsProbe>> queue;
+    shared_ptr<StatvfsProbe> current;
+    bool abandoned;
+
+    StatvfsWorker() : abandoned(false) {}
+    static void run(shared_ptr<StatvfsWorker> worker);
+};
+
+struct FilesystemMonitor {
+    static constexpr uint64_t REFRESH_MS = 5000;
+    static constexpr uint64_t TIMEOUT_MS = 2000;
+
+    struct Mount {
+        FilesystemInfo info;
+        char device[16];                   // "major:minor"; bind mounts of one device are shown once
+        shared_ptr<StatvfsProbe> probe;    // in flight, or null
+        uint64_t last_probe_ms;
+    };
+
+    int mountinfo_fd;           // polled by the sampler for POLLPRI on mount table changes
+    bool mounts_changed;
+    vector<char> buf;
+    vector<Mount> mounts;       // in mountinfo order
+    shared_ptr<StatvfsWorker> worker;
+
+    FilesystemMonitor() : mountinfo_fd(-1), mounts_changed(true) {}
+    ~FilesystemMonitor();
+    // Rereads the mount table if it changed, collects finished probes and queues
+    // due ones; true if anything visible changed
+    bool update(uint64_t now_ms);
+    void readMounts();
+    void startWorker();
+    void publish(vector<FilesystemInfo>& out) const;
+};
 vector<Proc> getProcesses();
+// Refills `processes`, reusing its storage; adds the CPU time of the scan threads to `worker_cpu`
+void getProcesses(vector<Proc>& processes, double* worker_cpu = nullptr);
+void countTaskStates(const vector<Proc>& processes, int counts[4]); // [running, sleeping, stopped, zombie]
+long long readTotalCPUTime(); // all jiffies on the "cpu" line of /proc/stat
+
+// One thread of an expanded process (threads.cpp)
+struct ThreadInfo {
+    int tid;
+    string name;
+    char state;
+    int last_cpu;         // processor it last ran on
+    long long cpu_time;   // utime + stime, clock ticks
+    double cpu_usage;     // % of total CPU time since the previous refresh
+};
+
+// Threads of one process from /proc/<pid>/task, refreshed incrementally
+struct ProcessThreads {
+    int pid;
+    long long starttime;  // of the process; a change means the pid was reused
+    long long prev_total_time;
+    vector<ThreadInfo> threads; // by tid on the sampler thread, by CPU% once published
+    vector<ThreadInfo> next;
+    vector<int> tids;
+
+    ProcessThreads(int pid = 0, long long starttime = 0) : pid(pid), starttime(starttime), prev_total_time(0) {}
+    // Rereads the threads; false once the process is gone
+    bool refresh(long long total_time, long long start);
+};
 void initializeCPUMeasurements();
 double getProcessCPUUsage(int pid);
 double getProcessMemoryUsage(int pid);
 
+// Proportional memory accounting from /proc/<pid>/smaps_rollup, in bytes
+struct SmapsRollup {
+    long long rss;
+    long long pss;          // shared pages split between the processes mapping them
+    long long uss;          // private clean + private dirty: freed if the process exits
+    long long shared_clean;
+    long long shared_dirty;
+    long long swap;
+    long long swap_pss;
+};
+bool readSmapsRollup(int pid, SmapsRollup& out);
+
+struct ProcessMemory {
+    int pid;
+    long long starttime;
+    bool readable;          // false if smaps_rollup is missing or not permitted
+    double updated;         // seconds of the last read, -1 = not read yet
+    SmapsRollup smaps;
+};
+
+// smaps_rollup results for the processes on screen or selected; reads the oldest
+// entries first within a time budget, so a long list is refreshed over several runs
+struct ProcessMemoryCache {
+    vector<ProcessMemory> entries; // by pid
+    vector<ProcessMemory> next;
+    vector<int> stale;
+
+    // `wanted` is (pid, starttime); true if anything changed
+    bool update(vector<pair<int, long long>> wanted, double now);
+};
+const ProcessMemory* findProcessMemory(const vector<ProcessMemory>& entries, const Proc& proc);
+
+// Process table ordering (proctable.cpp)
+enum ProcessColumn {
+    PROC_COL_PID,
+    PROC_COL_NAME,
+    PROC_COL_STATE,
+    PROC_COL_CPU,
+    PROC_COL_MEM,
+    PROC_COL_READ,
+    PROC_COL_WRITE,
+    PROC_COL_SYSCALLS,
+    PROC_COL_IO          // read + write bytes/s; not a column, sorts the top-I/O view
+};
+
+struct SortKey {
+    int column;          // ProcessColumn
+    bool descending;
+};
+
+// Cached permutation of snapshot rows in sort order.
+// order[0..sorted_count) is final; the rest is only known to sort after it.
+struct ProcessOrder {
+    // A row as it was when last ordered, kept in pid order so the next
+    // snapshot can be matched against it with a linear merge
+    struct OrderedRow {
+        int pid;
+        int rank;             // position in `order`
+        char state;
+        double cpu_usage;
+        double mem_usage;
+        double read_rate;
+        double write_rate;
+        double syscall_rate;
+        uint64_t name_hash;
+    };
+
+    vector<int> order;        // indices into the snapshot
+    vector<int> by_pid;       // the same indices, in pid order
+    vector<OrderedRow> ordered;
+    vector<SortKey> keys;
+    size_t sorted_count;
+
+    ProcessOrder() : sorted_count(0) {}
+
+    void setKeys(const vector<SortKey>& new_keys);
+    void update(const vector<Proc>& snapshot, const vector<int>& rows);
+    void ensureSorted(const vector<Proc>& snapshot, size_t count);
+};
+
+int compareProcs(const Proc& a, const Proc& b, const vector<SortKey>& keys);
+
+// Processes under their parents (proctree.cpp), each node with the CPU%, RSS
+// and thread totals of its subtree. update() merges a new snapshot against the
+// previous one and carries only the differences up the ancestor chain.
+struct ProcessTree {
+    struct Node {
+        long long starttime;
+        int parent;             // pid, 0 for a root
+        int index;              // into the snapshot of the last update
+        vector<int> children;   // pids
+        double cpu;             // own values, as counted in the totals
+        long long rss;          // pages
+        int threads;
+        double subtree_cpu;     // own plus all descendants
+        long long subtree_rss;
+        int subtree_threads;
+        int subtree_procs;
+        bool collapsed;         // shown as one row with the subtree totals
+        bool seen;
+    };
+
+    // A displayed row, depth first with siblings in table sort order
+    struct Row {
+        int index;              // into the snapshot
+        int depth;
+    };
+
+    unordered_map<int, Node> nodes;
+    vector<Row> rows;
+
+    void update(const vector<Proc>& snapshot);
+    void buildRows(const vector<Proc>& snapshot, const vector<int>& visible, const vector<SortKey>& keys);
+    const Node* find(int pid) const;
+    void toggleCollapsed(int pid);
+
+    void addUp(int pid, double cpu, long long rss, int threads, int procs);
+    void detach(int pid, Node& node);
+    void attach(int pid, Node& node, int parent);
+    void remove(int pid);
+};
+
+// Process filter expressions (proctable.cpp), e.g. "name~nginx cpu>5 state=R user=www".
+// Terms are ANDed; a bare word matches as a name substring.
+enum FilterOp {
+    FILTER_CONTAINS,     // ~
+    FILTER_NOT_CONTAINS, // !~
+    FILTER_EQ,           // =
+    FILTER_NE,           // !=
+    FILTER_LT,           // <
+    FILTER_LE,           // <=
+    FILTER_GT,           // >
+    FILTER_GE            // >=
+};
+
+struct FilterTerm {
+    int field;           // ProcessColumn, or PROC_FIELD_USER
+    int op;              // FilterOp
+    double number;       // numeric operand (pid, cpu, mem, uid)
+    string text;         // text operand, lowercased when ignoring case
+};
+
+const int PROC_FIELD_USER = 100;
+const int PROC_FIELD_CMD = 101;
+
+struct CmdlineIndex;
+
+struct ProcessFilter {
+    vector<FilterTerm> terms;
+    bool ignore_case;
+    string error;        // first parse error, empty if the whole expression compiled
+
+    ProcessFilter() : ignore_case(false) {}
+
+    void compile(const string& text, bool icase);
+    bool usesCmdline() const;
+    // `cmdlines` should be synced with `snapshot` when usesCmdline() is true
+    void apply(const vector<Proc>& snapshot, vector<int>& rows, const CmdlineIndex& cmdlines) const;
+};
+
+// memchr-based substring search; `needle` must already be lowercase when icase is set
+bool containsText(const char* hay, size_t hay_len, const string& needle, bool icase);
+
+// Command line search (cmdline.cpp).
+// /proc/<pid>/cmdline is loaded once per (pid, starttime), and only from the first
+// sync() on, so nothing is read until a filter actually searches command lines.
+// The sampler thread syncs it and publishes it with the samples.
+// Every command line is indexed by its lowercase trigrams; a query intersects the
+// posting lists of the needle's trigrams and verifies just those candidates.
+struct CmdlineIndex {
+    struct Doc {
+        int pid;
+        long long starttime;
+        bool alive;
+        string text;          // arguments joined with spaces
+    };
+
+    vector<Doc> docs;                              // doc id -> document; ids only grow between compactions
+    unordered_map<int, uint32_t> by_pid;                     // live pid -> doc id
+    unordered_map<uint32_t, vector<uint32_t>> postings;      // trigram -> ascending doc ids (may include dead ones)
+    size_t dead_count;
+
+    CmdlineIndex() : dead_count(0) {}
+
+    // `keys` are the (pid, starttime) of a scan, sorted by pid
+    void sync(const vector<pair<int, long long>>& keys);
+    bool matches(const vector<pair<int, long long>>& keys) const;
+    // Sorted pids whose command line contains `needle` (lowercase when icase)
+    void search(const string& needle, bool icase, pmr::vector<int>& pids) const;
+
+    void addDoc(int pid, long long starttime);
+    void removeDoc(uint32_t id);
+    void compact();
+};
+
 // Network monitoring functions
 struct NetworkInterface {
     string name;
@@ -176,7 +784,327 @@ struct NetworkInterface {
     long long tx_dropped;
 };
 
-vector<NetworkInterface> getNetworkInterfaces();
+pmr::vector<NetworkInterface> getNetworkInterfaces(pmr::memory_resource* mr = pmr::get_default_resource());
+
+// Value formatting (format.cpp).
+// The buffer versions write into caller storage with to_chars and never allocate;
+// they always NUL-terminate (truncating if needed) and return `buf`.
+const char* formatBytes(char* buf, size_t size, long long bytes);        // "1.50 GB"
+const char* formatMemoryBytes(char* buf, size_t size, long long bytes);  // "2 GB", rounded to whole units
+const char* formatUsage(char* buf, size_t size, long long used, long long total, double percentage); // "3 GB / 8 GB (37%)"
 string formatBytes(long long bytes);
 
+// A label that is only re-formatted when the values it shows change
+struct CachedLabel {
+    long long key[3];
+    bool valid;
+    char text[96];
+
+    CachedLabel() : valid(false) { text[0] = '\0'; }
+
+    // True (and remembers the values) if the text must be rebuilt for them
+    bool changed(long long a, long long b = 0, long long c = 0) {
+        if (valid && key[0] == a && key[1] == b && key[2] == c) return false;
+        key[0] = a;
+        key[1] = b;
+        key[2] = c;
+        valid = true;
+        return true;
+    }
+};
+
+
+// The monitor's own overhead (self.cpp), sampled from /proc/self
+struct ThreadCPU {
+    int tid;
+    char name[16];      // comm, at most 15 characters
+    long long ticks;    // utime + stime
+    double cpu_usage;   // % of one CPU since the previous sample
+};
+
+struct SelfMonitor {
+    static const size_t SELF_HISTORY = 120;
+
+    vector<ThreadCPU> threads;
+    vector<ThreadCPU> next_threads;
+    double cpu_usage;             // all threads, % of one CPU
+    long long rss;                // bytes
+    double syscalls_read_rate;    // per second, from /proc/self/io syscr
+    double syscalls_write_rate;   // per second, syscw
+    double allocs_rate;           // per second; only with TRACK_ALLOC=1
+    bool allocs_tracked;
+    vector<float> cpu_history;
+
+    // Overhead budget; overBudget() drives the alarm
+    float cpu_budget;             // % of one CPU
+    float rss_budget_mb;
+
+    double last_time;
+    long long prev_syscr;
+    long long prev_syscw;
+    long long prev_allocs;
+
+    SelfMonitor() : cpu_usage(0.0), rss(0), syscalls_read_rate(0.0), syscalls_write_rate(0.0),
+                    allocs_rate(0.0), allocs_tracked(false), cpu_budget(2.0f), rss_budget_mb(100.0f),
+                    last_time(0.0), prev_syscr(0), prev_syscw(0), prev_allocs(0) {}
+
+    void sample(double now);
+    bool overBudget() const;
+};
+
+
+// Overhead governor (governor.cpp): keeps the CPU spent in expensive collectors
+// under a budget by stretching their intervals, and shrinks them back when cheap
+enum GovernedId { GOV_PROCESSES, GOV_TASKS, GOV_CMDLINE, GOV_SENSORS, GOV_CGROUPS, GOV_COUNT };
+
+struct GovernedCollector {
+    const char* name;
+    double base_interval;   // seconds, when there is budget to spare
+    double interval;        // base_interval * slowdown
+    int slowdown;           // power of two, 1..16
+    double last_run;
+    double cost_ms;         // smoothed CPU time per run
+    double cpu_share;       // % of one core at the current interval: cost_ms / interval
+};
+
+// The sampler thread records and adjusts while the UI reads the table and
+// edits the settings, so everything is guarded by `lock`
+struct Governor {
+    mutable mutex lock;
+    GovernedCollector collectors[GOV_COUNT];
+    bool enabled;
+    float cpu_budget;       // % of one core for all governed collectors together
+    bool idle_priority;     // wanted; the sampler thread applies it
+    double window_start;
+    double collection_cpu;  // % of one core, the sum of the shares
+
+    Governor();
+    bool due(int id, double now) const;
+    double nextDue(int id) const;
+    double interval(int id) const;
+    void record(int id, double now, double cpu_seconds);
+    void adjust(double now);
+    static bool applyIdlePriority(bool on); // SCHED_IDLE (or nice 19) for the calling thread
+};
+
+double threadCpuSeconds();  // CPU time of the calling thread
+
+// Times one collector run in thread CPU time and reports it to the governor
+struct GovernorRun {
+    Governor& governor;
+    int id;
+    double now;
+    double cpu_start;
+    double worker_cpu;      // CPU seconds the run spent on other threads, added by the collector
+    GovernorRun(Governor& governor, int id, double now);
+    ~GovernorRun();
+};
+
+
+// Sampling scheduler (scheduler.cpp).
+// Every collector has its own period on a timer wheel; a sampler thread runs them
+// and the UI picks up the results with Sampler::read() once per frame.
+enum SampleId {
+    SAMPLE_CPU,
+    SAMPLE_MEMORY,      // RAM and swap
+    SAMPLE_DISK,
+    SAMPLE_NETWORK,
+    SAMPLE_SENSORS,     // thermal and fan
+    SAMPLE_TASKS,
+    SAMPLE_PROCESSES,
+    SAMPLE_THREADS,     // threads of expanded processes
+    SAMPLE_SMAPS,       // PSS/USS of visible and selected processes
+    SAMPLE_DISKSTATS,   // block device throughput and latency
+    SAMPLE_FILESYSTEMS, // capacity and inodes of every mount
+    SAMPLE_PRESSURE,    // PSI stall times
+    SAMPLE_CGROUPS,     // cgroup v2 tree, governed
+    SAMPLE_CMDLINES,    // command line index, governed, only while a filter uses it
+    SAMPLE_COUNT
+};
+
+struct WheelTimer {
+    uint64_t interval;  // ms
+    uint64_t slack;     // ms it may fire late to share another timer's wakeup
+    uint64_t deadline;  // ms, CLOCK_MONOTONIC
+    int level;          // 0, 1, 2 = overflow, -1 = not placed
+    int slot;
+};
+
+struct TimerWheel {
+    static constexpr int SLOTS = 64;
+    static constexpr uint64_t TICK_MS = 10;
+
+    vector<WheelTimer> timers;
+    vector<int> level0[SLOTS];  // timer ids due on each of the next SLOTS ticks
+    vector<int> level1[SLOTS];  // ... on each of the next SLOTS revolutions
+    vector<int> overflow;
+    vector<int> scratch;
+    size_t level0_count;
+    uint64_t tick;              // last tick processed
+
+    TimerWheel() : level0_count(0), tick(0) {}
+    void reset(uint64_t now);
+    int add(uint64_t interval, uint64_t slack, uint64_t now); // first run at `now`
+    void setInterval(int id, uint64_t interval, uint64_t now);
+    void advance(uint64_t now, vector<int>& fired);           // fires and re-arms due timers
+    uint64_t nextWake() const;  // ms; UINT64_MAX if nothing is scheduled
+    void place(int id);
+    void unplace(int id);
+};
+
+// Per-metric sampling rate: jumps towards `fastest` when the value moves by more
+// than `threshold`, and backs off towards `slowest` while it stays put
+struct AdaptiveRate {
+    double fastest;    // seconds; 0 = not adaptive
+    double slowest;
+    double interval;
+    double threshold;  // in the metric's own units
+    int stable;        // unchanged samples since the last step
+    bool has_last;
+    double last;
+
+    AdaptiveRate() : fastest(0.0), slowest(0.0), interval(0.0), threshold(0.0),
+                     stable(0), has_last(false), last(0.0) {}
+    void setup(double fast, double slow, double change);
+    // Takes a new sample and returns the interval until the next one
+    double update(double value);
+};
+
+struct SampleSet {
+    uint64_t seq[SAMPLE_COUNT];  // bumped on every new sample of that kind
+    double cpu_usage;
+    double cpu_elapsed;          // seconds of CPU samples since the previous read, 0 at first
+    MemoryInfo memory;
+    MemoryInfo swap;
+    DiskInfo disk;
+    vector<NetworkInterface> interfaces;
+    double temperature;
+    char fan_status[64];
+    int fan_speed;
+    int task_counts[4];          // processes by state: [running, sleeping, stopped, zombie]
+    TaskSummary tasks;           // thread counts, refreshed far more often
+    vector<Proc> processes;
+    vector<ProcessThreads> threads;
+    vector<ProcessMemory> process_memory; // by pid
+    DiskStats diskstats;
+    vector<FilesystemInfo> filesystems; // in mount order
+    PressureStats pressure;
+    vector<CgroupInfo> cgroups;  // depth first
+    vector<pair<int, int>> cgroup_members; // (pid, index into cgroups), by pid
+    shared_ptr<const CmdlineIndex> cmdlines; // never null; read only, the sampler syncs its own copy
+
+    SampleSet() : cpu_usage(0.0), cpu_elapsed(0.0), memory(), swap(), disk(), temperature(0.0), fan_speed(-1),
+                  cmdlines(make_shared<CmdlineIndex>()) {
+        memset(seq, 0, sizeof(seq));
+        fan_status[0] = '\0';
+        memset(task_counts, 0, sizeof(task_counts));
+        memset(&tasks, 0, sizeof(tasks));
+    }
+};
+
+struct Sampler {
+    TimerWheel wheel;           // sampler thread only
+    Governor* governor;
+    SampleSet shared;           // guarded by `lock`
+    mutex lock;
+    thread worker;
+    int timer_fd;
+    int wake_fd;
+    atomic<bool> running;
+    atomic<bool> paused;
+    atomic<bool> event_pending; // an SDL event is queued and not yet read
+    Uint32 event_type;
+    atomic<uint64_t> requested[SAMPLE_COUNT]; // new interval in ms from the UI, 0 = none
+    atomic<uint64_t> current_interval[SAMPLE_COUNT]; // ms, for display
+    atomic<bool> adaptive_enabled;
+    vector<pair<int, long long>> expanded; // (pid, starttime) to read threads of; guarded by `lock`
+    vector<pair<int, long long>> memory_wanted; // (pid, starttime) to read smaps_rollup of; same
+    atomic<bool> cmdlines_wanted; // a filter searches command lines
+
+    // Sampler thread state
+    AdaptiveRate adaptive[SAMPLE_COUNT];
+    CPUStats prev_cpu;
+    bool have_prev_cpu;
+    uint64_t last_cpu_ms;
+    bool have_prev_net;
+    long long prev_net_bytes;
+    uint64_t last_net_ms;
+    bool idle_applied;
+    vector<Proc> processes;
+    vector<pair<int, long long>> process_keys; // (pid, starttime) of the last scan, by pid
+    vector<ProcessThreads> thread_groups;
+    ProcessMemoryCache memory_cache;
+    DiskStatsReader diskstats_reader;
+    DiskStats diskstats;
+    FilesystemMonitor filesystems;
+    PressureReader pressure_reader;
+    PressureStats pressure;
+    CgroupMonitor cgroups;
+    shared_ptr<CmdlineIndex> cmdline_index; // also published while the UI holds it; copied before a sync then
+    bool cmdlines_synced;       // cmdline_index was synced while cmdlines_wanted was on
+    pmr::unsynchronized_pool_resource pool;
+
+    Sampler();
+    void start(Governor* governor, Uint32 event_type);
+    void stop();
+    void setInterval(int id, double seconds);
+    void setPaused(bool on);
+    void setExpanded(const vector<pair<int, long long>>& processes);
+    void setMemoryWanted(const vector<pair<int, long long>>& processes);
+    void setCmdlinesWanted(bool on);
+    // Copies anything new into `out` and flags it in `changed`; false if nothing was
+    bool read(SampleSet& out, bool changed[SAMPLE_COUNT]);
+    void wake();
+    void run();
+    // Returns the value adaptive sampling compares between samples
+    double collect(int id, uint64_t now_ms);
+};
+
+// Worker threads that split one job into indexed chunks; see pool.cpp
+struct WorkerPool {
+    vector<thread> workers;
+    mutex lock;
+    condition_variable start_cv;
+    condition_variable done_cv;
+    const function<void(int)>* job; // guarded by `lock` while posting
+    int job_count;
+    atomic<int> next;               // next chunk to claim
+    int active;                     // workers still on the current job
+    uint64_t generation;            // bumped for each job
+    bool stopping;
+    double worker_cpu;              // CPU seconds the workers spent on the last job
+
+    WorkerPool();
+    ~WorkerPool();
+    void resize(int threads);
+    // Runs body(0) .. body(count - 1) on the pool and the calling thread;
+    // returns the CPU seconds the pool threads spent on it
+    double parallelFor(int count, const function<void(int)>& body);
+    void drain();
+    void workerLoop(int index, uint64_t seen);
+};
+
+// Batched file reads over io_uring; see uring.cpp
+static const unsigned URING_BATCH = 256;
+
+struct UringRead {
+    int dir_fd;              // `path` and `stat_path` may be relative to this
+    const char* path;
+    char* buf;
+    size_t size;
+    ssize_t length;          // bytes read, or < 0 on error
+    const char* stat_path;   // also statx() this path, or nullptr
+    struct statx stx;        // stx_uid is -1 if the statx failed
+};
+
+// Reads up to URING_BATCH files; false if io_uring is off or unusable, in which
+// case nothing was read and the caller falls back to readProcFile()
+bool uringReadBatch(UringRead* reads, int count);
+void setUseUring(bool on);
+bool useUring();
+bool uringUnavailable();     // setup failed (old kernel, seccomp, io_uring_disabled)
+
+int scanThreads();                  // extra threads for a process scan, 0 = scan inline
+void setScanThreads(int threads);   // -1 = pick from the core count
+
 #endif
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <map>
 #include <cmath>
+#include <string.h>
 
 /*
 NOTE : You are free to change the code as you wish, the main objective is to make the
@@ -44,16 +45,52 @@ using namespace gl;
 #include IMGUI_IMPL_OPENGL_LOADER_CUSTOM
 #endif
 
+// Collected on the sampler thread; `samples` is the UI's copy, refreshed each frame
+static Governor governor;
+static Sampler sampler;
+static SampleSet samples;
+static bool sampleChanged[SAMPLE_COUNT];
+// A new process snapshot the table hasn't rebuilt its rows from yet. The table
+// isn't drawn while its window is collapsed, and row indices into the old
+// snapshot must not outlive it, so the edge is held until the rebuild runs.
+static bool processesDirty = false;
+static bool cmdlinesDirty = false; // same for a newly published command line index
+
 // Global variables for system window state
-static CPUStats prevCPUStats = {0};
 static GraphData cpuGraph(100);
 static GraphData thermalGraph(100);
 static GraphData fanGraph(100);
-static bool firstRun = true;
+static SelfMonitor selfMonitor;
+static const double SELF_SAMPLE_INTERVAL = 1.0;
+
+static const Proc* findProcess(int pid)
+{
+    auto it = std::lower_bound(samples.processes.begin(), samples.processes.end(), pid,
+                               [](const Proc& p, int id) { return p.pid < id; });
+    return (it != samples.processes.end() && it->pid == pid) ? &*it : nullptr;
+}
+
+// Graphs grow when a new sample arrives, whether or not their tab is open
+static void updateGraphs()
+{
+    if (sampleChanged[SAMPLE_CPU] && cpuGraph.animate) {
+        cpuGraph.addSample(samples.cpu_usage, samples.cpu_elapsed);
+    }
+    if (sampleChanged[SAMPLE_SENSORS]) {
+        if (thermalGraph.animate && thermalGraph.shouldUpdate()) {
+            thermalGraph.addValue(samples.temperature);
+        }
+        if (fanGraph.animate && samples.fan_speed >= 0 && fanGraph.shouldUpdate()) {
+            fanGraph.addValue(samples.fan_speed);
+        }
+    }
+}
 
 // systemWindow, display information for the system monitorization
 void systemWindow(const char *id, ImVec2 size, ImVec2 position)
 {
+    ALLOC_SCOPE("systemWindow");
+    PROFILE_SCOPE("systemWindow");
     ImGui::Begin(id);
     ImGui::SetWindowSize(id, size);
     ImGui::SetWindowPos(id, position);
@@ -62,16 +99,34 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::Separator();
     ImGui::Spacing();
 
+    // These don't change while we run; look them up once instead of every frame
+    static const string loggedUser = getLoggedUser();
+    static const string hostname = getHostname();
+    static const string cpuName = CPUinfo();
+
     ImGui::Text("Operating System: %s", getOsName());
-    ImGui::Text("User: %s", getLoggedUser().c_str());
-    ImGui::Text("Hostname: %s", getHostname().c_str());
-    ImGui::Text("CPU: %s", CPUinfo().c_str());
+    ImGui::Text("User: %s", loggedUser.c_str());
+    ImGui::Text("Hostname: %s", hostname.c_str());
+    ImGui::Text("CPU: %s", cpuName.c_str());
 
-    // Task counts
-    vector<int> taskCounts = getTaskCounts();
+    // Task counts: processes by state with each process scan, threads on every tick
+    const int *taskCounts = samples.task_counts;
     ImGui::Text("Tasks: %d running, %d sleeping, %d stopped, %d zombie",
                 taskCounts[0], taskCounts[1], taskCounts[2], taskCounts[3]);
     ImGui::Text("Total Tasks: %d", taskCounts[0] + taskCounts[1] + taskCounts[2] + taskCounts[3]);
+    ImGui::Text("Threads: %d, %d runnable, %d blocked on I/O",
+                samples.tasks.threads, samples.tasks.running, samples.tasks.blocked);
+
+    // The monitor's own cost is sampled even while its tab is hidden, so the alarm can fire
+    double now = SDL_GetTicks() / 1000.0;
+    if (now - selfMonitor.last_time >= SELF_SAMPLE_INTERVAL) {
+        selfMonitor.sample(now);
+    }
+    if (selfMonitor.overBudget()) {
+        char rss[32];
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Monitor overhead over budget: %.1f%% CPU, %s RSS",
+                           selfMonitor.cpu_usage, formatBytes(rss, sizeof(rss), selfMonitor.rss));
+    }
 
     ImGui::Spacing();
     ImGui::Separator();
@@ -81,24 +136,13 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
 
         // CPU Tab
         if (ImGui::BeginTabItem("CPU")) {
-            CPUStats currentCPU = getCPUStats();
-            double cpuUsage = 0.0;
-
-            if (!firstRun) {
-                cpuUsage = calculateCPUUsage(prevCPUStats, currentCPU);
-            }
-            prevCPUStats = currentCPU;
-            firstRun = false;
+            ImGui::Text("CPU Usage: %.1f%%", samples.cpu_usage);
 
-            if (cpuGraph.animate && cpuGraph.shouldUpdate()) {
-                cpuGraph.addValue(cpuUsage);
-            }
-
-            ImGui::Text("CPU Usage: %.1f%%", cpuUsage);
-
-            // Graph controls
+            // Graph controls; the FPS slider is the CPU collector's sampling rate
             ImGui::Checkbox("Animate", &cpuGraph.animate);
-            ImGui::SliderFloat("FPS", &cpuGraph.fps, 1.0f, 120.0f);
+            if (ImGui::SliderFloat("FPS", &cpuGraph.fps, 1.0f, 120.0f)) {
+                sampler.setInterval(SAMPLE_CPU, 1.0 / cpuGraph.fps);
+            }
             ImGui::SliderFloat("Y Scale", &cpuGraph.y_scale, 50.0f, 200.0f);
 
             // CPU Graph
@@ -112,21 +156,14 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
 
         // Fan Tab
         if (ImGui::BeginTabItem("Fan")) {
-            string fanStatus = getFanStatus();
-            int fanSpeed = getFanSpeed();
+            ImGui::Text("Fan Status: %s", samples.fan_status);
 
-            ImGui::Text("Fan Status: %s", fanStatus.c_str());
-
-            if (fanSpeed >= 0) {
-                ImGui::Text("Fan Speed: %d RPM", fanSpeed);
+            if (samples.fan_speed >= 0) {
+                ImGui::Text("Fan Speed: %d RPM", samples.fan_speed);
             } else {
                 ImGui::Text("Fan Speed: Not Available");
             }
 
-            if (fanGraph.animate && fanSpeed >= 0 && fanGraph.shouldUpdate()) {
-                fanGraph.addValue(fanSpeed);
-            }
-
             // Graph controls
             ImGui::Checkbox("Animate##Fan", &fanGraph.animate);
             ImGui::SliderFloat("FPS##Fan", &fanGraph.fps, 1.0f, 120.0f);
@@ -150,13 +187,7 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
 
         // Thermal Tab
         if (ImGui::BeginTabItem("Thermal")) {
-            double temperature = getThermalTemp();
-
-            ImGui::Text("Temperature: %.1f°C", temperature);
-
-            if (thermalGraph.animate && thermalGraph.shouldUpdate()) {
-                thermalGraph.addValue(temperature);
-            }
+            ImGui::Text("Temperature: %.1f°C", samples.temperature);
 
             // Graph controls
             ImGui::Checkbox("Animate##Thermal", &thermalGraph.animate);
@@ -172,6 +203,453 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
             ImGui::EndTabItem();
         }
 
+        // Pressure Tab: PSI, i.e. time tasks spent waiting on each resource
+        if (ImGui::BeginTabItem("Pressure")) {
+            static const char* resources[PRESSURE_COUNT] = {"CPU", "Memory", "I/O"};
+            const PressureStats& pressure = samples.pressure;
+            bool any = false;
+            for (const PressureResourceStats& res : pressure.resources) {
+                any = any || res.available;
+            }
+            if (!any) {
+                ImGui::TextDisabled("/proc/pressure is not available (kernel without PSI, or booted with psi=0)");
+            } else if (ImGui::BeginTable("pressure", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Resource");
+                ImGui::TableSetupColumn("Some now");
+                ImGui::TableSetupColumn("avg10");
+                ImGui::TableSetupColumn("avg60");
+                ImGui::TableSetupColumn("avg300");
+                ImGui::TableSetupColumn("Full now");
+                ImGui::TableSetupColumn("avg10##full");
+                ImGui::TableSetupColumn("Stalled total");
+                ImGui::TableHeadersRow();
+                for (int i = 0; i < PRESSURE_COUNT; i++) {
+                    const PressureResourceStats& res = pressure.resources[i];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(resources[i]);
+                    if (!res.available) {
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::TextDisabled("n/a");
+                        continue;
+                    }
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%.2f%%", res.some.rate);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.2f", res.some.avg10);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.2f", res.some.avg60);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%.2f", res.some.avg300);
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::Text("%.2f%%", res.full.rate);
+                    ImGui::TableSetColumnIndex(6);
+                    ImGui::Text("%.2f", res.full.avg10);
+                    ImGui::TableSetColumnIndex(7);
+                    ImGui::Text("%.1fs", res.some.total / 1e6);
+                }
+                ImGui::EndTable();
+            }
+
+            // Stall share of each sampling interval; "some" over "full" per resource
+            for (int i = 0; i < PRESSURE_COUNT; i++) {
+                const PressureResourceStats& res = pressure.resources[i];
+                if (!res.available || res.history_len == 0) continue;
+                int offset = res.history_len < PRESSURE_HISTORY ? 0 : res.history_pos;
+                float top = 5.0f;
+                for (int j = 0; j < res.history_len; j++) {
+                    top = max(top, res.some_history[j]);
+                }
+                top = min(top * 1.2f, 100.0f);
+                char label[48];
+                snprintf(label, sizeof(label), "%s some %%", resources[i]);
+                ImGui::PlotLines(label, res.some_history, res.history_len, offset, nullptr, 0.0f, top, ImVec2(0, 50));
+                snprintf(label, sizeof(label), "%s full %%", resources[i]);
+                ImGui::PlotLines(label, res.full_history, res.history_len, offset, nullptr, 0.0f, top, ImVec2(0, 50));
+            }
+
+            ImGui::EndTabItem();
+        }
+
+        // Disk I/O Tab: per-device activity from /proc/diskstats
+        if (ImGui::BeginTabItem("Disk I/O")) {
+            const DiskStats& disks = samples.diskstats;
+            if (disks.count == 0) {
+                ImGui::TextDisabled("No block devices in /proc/diskstats");
+            }
+            // The selection is kept by name; devices come and go with hotplug
+            static char selectedDisk[DISK_NAME_MAX] = "";
+            const DiskDevice* selected = nullptr;
+            if (disks.count > 0 && ImGui::BeginTable("diskstats", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Device");
+                ImGui::TableSetupColumn("Reads/s");
+                ImGui::TableSetupColumn("Writes/s");
+                ImGui::TableSetupColumn("Read/s");
+                ImGui::TableSetupColumn("Write/s");
+                ImGui::TableSetupColumn("Await");
+                ImGui::TableSetupColumn("Queue");
+                ImGui::TableSetupColumn("Util");
+                ImGui::TableHeadersRow();
+                for (int i = 0; i < disks.count; i++) {
+                    const DiskDevice& dev = disks.devices[i];
+                    if (selectedDisk[0] == '\0') strcpy(selectedDisk, dev.name);
+                    bool is_selected = strcmp(selectedDisk, dev.name) == 0;
+                    if (is_selected) selected = &dev;
+
+                    char text[32];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    if (ImGui::Selectable(dev.name, is_selected, ImGuiSelectableFlags_SpanAllColumns)) {
+                        strcpy(selectedDisk, dev.name);
+                    }
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%.0f", dev.read_iops);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.0f", dev.write_iops);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::TextUnformatted(formatBytes(text, sizeof(text), (long long)dev.read_rate));
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::TextUnformatted(formatBytes(text, sizeof(text), (long long)dev.write_rate));
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::Text("%.2f ms", dev.await_ms);
+                    ImGui::TableSetColumnIndex(6);
+                    ImGui::Text("%llu", dev.in_flight);
+                    ImGui::TableSetColumnIndex(7);
+                    // Saturated devices stand out; that is what this tab is for
+                    if (dev.utilization >= 90.0) {
+                        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%.1f%%", dev.utilization);
+                    } else {
+                        ImGui::Text("%.1f%%", dev.utilization);
+                    }
+                }
+                ImGui::EndTable();
+            }
+
+            if (selected != nullptr && selected->history_len > 0) {
+                const DiskDevice& dev = *selected;
+                // Once full, the ring's oldest sample is at history_pos
+                int offset = dev.history_len < DISK_HISTORY ? 0 : dev.history_pos;
+                char label[64];
+                snprintf(label, sizeof(label), "%s util %%", dev.name);
+                ImGui::PlotLines(label, dev.util_history, dev.history_len, offset,
+                                 nullptr, 0.0f, 100.0f, ImVec2(0, 60));
+
+                float top_bytes = 1024.0f * 1024.0f;
+                float top_await = 1.0f;
+                for (int i = 0; i < dev.history_len; i++) {
+                    top_bytes = max(top_bytes, dev.bytes_history[i]);
+                    top_await = max(top_await, dev.await_history[i]);
+                }
+                char bytes[32];
+                char peak[48];
+                snprintf(peak, sizeof(peak), "peak %s/s", formatBytes(bytes, sizeof(bytes), (long long)top_bytes));
+                snprintf(label, sizeof(label), "%s throughput", dev.name);
+                ImGui::PlotLines(label, dev.bytes_history, dev.history_len, offset,
+                                 peak, 0.0f, top_bytes * 1.2f, ImVec2(0, 60));
+                snprintf(label, sizeof(label), "%s await ms", dev.name);
+                ImGui::PlotLines(label, dev.await_history, dev.history_len, offset,
+                                 nullptr, 0.0f, top_await * 1.2f, ImVec2(0, 60));
+            }
+
+            ImGui::EndTabItem();
+        }
+
+        // Filesystems Tab: every mount, measured off the UI and sampler threads
+        if (ImGui::BeginTabItem("Filesystems")) {
+            const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable |
+                                          ImGuiTableFlags_ScrollY;
+            if (ImGui::BeginTable("filesystems", 7, flags, ImVec2(0, ImGui::GetContentRegionAvail().y))) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Mounted on");
+                ImGui::TableSetupColumn("Device");
+                ImGui::TableSetupColumn("Type");
+                ImGui::TableSetupColumn("Size");
+                ImGui::TableSetupColumn("Used");
+                ImGui::TableSetupColumn("Avail");
+                ImGui::TableSetupColumn("Inodes");
+                ImGui::TableHeadersRow();
+                for (const FilesystemInfo& fs : samples.filesystems) {
+                    char text[48];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(fs.mount_point.c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(fs.source.c_str());
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::TextUnformatted(fs.fstype.c_str());
+                    ImGui::TableSetColumnIndex(3);
+                    if (fs.state == FS_HUNG) {
+                        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "not responding");
+                        continue;
+                    } else if (fs.state == FS_ERROR) {
+                        ImGui::TextDisabled("unavailable");
+                        continue;
+                    } else if (fs.state == FS_PENDING) {
+                        ImGui::TextDisabled("...");
+                        continue;
+                    }
+                    ImGui::TextUnformatted(formatBytes(text, sizeof(text), fs.total));
+                    ImGui::TableSetColumnIndex(4);
+                    char used[32];
+                    snprintf(text, sizeof(text), "%s (%.0f%%)", formatBytes(used, sizeof(used), fs.used), fs.percentage);
+                    if (fs.percentage >= 90.0) {
+                        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", text);
+                    } else {
+                        ImGui::TextUnformatted(text);
+                    }
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::TextUnformatted(formatBytes(text, sizeof(text), fs.available));
+                    ImGui::TableSetColumnIndex(6);
+                    if (fs.inodes_total == 0) {
+                        ImGui::TextDisabled("-");
+                    } else if (fs.inodes_percentage >= 90.0) {
+                        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%lld / %lld (%.0f%%)",
+                                           fs.inodes_used, fs.inodes_total, fs.inodes_percentage);
+                    } else {
+                        ImGui::Text("%lld / %lld (%.0f%%)", fs.inodes_used, fs.inodes_total, fs.inodes_percentage);
+                    }
+                }
+                ImGui::EndTable();
+            }
+
+            ImGui::EndTabItem();
+        }
+
+        // cgroups Tab: the cgroup v2 tree; every row covers its whole subtree
+        if (ImGui::BeginTabItem("cgroups")) {
+            const vector<CgroupInfo>& cgroups = samples.cgroups;
+            static string selectedCgroup;
+            int selected = -1;
+            if (cgroups.empty()) {
+                ImGui::TextDisabled("No cgroup v2 hierarchy mounted");
+            }
+            const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable |
+                                          ImGuiTableFlags_ScrollY;
+            if (!cgroups.empty() &&
+                ImGui::BeginTable("cgroups", 7, flags, ImVec2(0, ImGui::GetContentRegionAvail().y * 0.65f))) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("cgroup", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("CPU %");
+                ImGui::TableSetupColumn("Memory");
+                ImGui::TableSetupColumn("Read/s");
+                ImGui::TableSetupColumn("Write/s");
+                ImGui::TableSetupColumn("Tasks");
+                ImGui::TableSetupColumn("Procs");
+                ImGui::TableHeadersRow();
+
+                // Rows are depth first; a collapsed node skips to the end of its subtree
+                pmr::vector<int> open_ends(frameArena());
+                int i = 0;
+                while (i < (int)cgroups.size()) {
+                    while (!open_ends.empty() && open_ends.back() <= i) {
+                        ImGui::TreePop();
+                        open_ends.pop_back();
+                    }
+                    const CgroupInfo& cg = cgroups[i];
+                    bool leaf = cg.subtree_end == i + 1;
+                    bool is_selected = cg.path == selectedCgroup;
+                    if (is_selected) selected = i;
+
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGuiTreeNodeFlags node_flags = ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_OpenOnArrow;
+                    if (leaf) node_flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+                    if (i == 0) node_flags |= ImGuiTreeNodeFlags_DefaultOpen;
+                    if (is_selected) node_flags |= ImGuiTreeNodeFlags_Selected;
+                    bool open = ImGui::TreeNodeEx(i == 0 ? "/" : cg.name.c_str(), node_flags, "%s", cg.name.c_str());
+                    if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
+                        selectedCgroup = cg.path;
+                    }
+
+                    char text[32];
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%.1f", cg.cpu_usage);
+                    ImGui::TableSetColumnIndex(2);
+                    if (cg.memory >= 0) {
+                        ImGui::TextUnformatted(formatBytes(text, sizeof(text), cg.memory));
+                        if (ImGui::IsItemHovered()) {
+                            char anon[32], file[32];
+                            ImGui::SetTooltip("anon %s, page cache %s", formatBytes(anon, sizeof(anon), cg.anon),
+                                              formatBytes(file, sizeof(file), cg.file));
+                        }
+                    } else {
+                        ImGui::TextDisabled("-");
+                    }
+                    ImGui::TableSetColumnIndex(3);
+                    if (cg.read_rate >= 0.0) {
+                        ImGui::TextUnformatted(formatBytes(text, sizeof(text), (long long)cg.read_rate));
+                    } else {
+                        ImGui::TextDisabled("-");
+                    }
+                    ImGui::TableSetColumnIndex(4);
+                    if (cg.write_rate >= 0.0) {
+                        ImGui::TextUnformatted(formatBytes(text, sizeof(text), (long long)cg.write_rate));
+                    } else {
+                        ImGui::TextDisabled("-");
+                    }
+                    ImGui::TableSetColumnIndex(5);
+                    if (cg.tasks >= 0) {
+                        ImGui::Text("%lld", cg.tasks);
+                    } else {
+                        ImGui::TextDisabled("-");
+                    }
+                    ImGui::TableSetColumnIndex(6);
+                    ImGui::Text("%d", cg.procs);
+
+                    if (leaf) {
+                        i++;
+                    } else if (open) {
+                        open_ends.push_back(cg.subtree_end);
+                        i++;
+                    } else {
+                        i = cg.subtree_end;
+                    }
+                }
+                while (!open_ends.empty()) {
+                    ImGui::TreePop();
+                    open_ends.pop_back();
+                }
+                ImGui::EndTable();
+            }
+
+            // Processes directly in the selected cgroup
+            if (selected >= 0) {
+                const CgroupInfo& cg = cgroups[selected];
+                ImGui::Text("%s: %d processes", selected == 0 ? "/" : cg.path.c_str(), cg.procs);
+                if (cg.procs > 0 && ImGui::BeginTable("cgroupProcs", 3, flags, ImVec2(0, ImGui::GetContentRegionAvail().y))) {
+                    ImGui::TableSetupScrollFreeze(0, 1);
+                    ImGui::TableSetupColumn("PID");
+                    ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+                    ImGui::TableSetupColumn("CPU %");
+                    ImGui::TableHeadersRow();
+                    for (const pair<int, int>& member : samples.cgroup_members) {
+                        if (member.second != selected) continue;
+                        const Proc* proc = findProcess(member.first);
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::Text("%d", member.first);
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::TextUnformatted(proc != nullptr ? proc->name.c_str() : "?");
+                        ImGui::TableSetColumnIndex(2);
+                        if (proc != nullptr) ImGui::Text("%.1f", proc->cpu_usage);
+                    }
+                    ImGui::EndTable();
+                }
+            }
+
+            ImGui::EndTabItem();
+        }
+
+        // Monitor Tab: this process' own overhead
+        if (ImGui::BeginTabItem("Monitor")) {
+            char rss[32];
+            ImGui::Text("CPU: %.2f%% of one core", selfMonitor.cpu_usage);
+            ImGui::Text("RSS: %s", formatBytes(rss, sizeof(rss), selfMonitor.rss));
+            ImGui::Text("Syscalls/s: %.0f read, %.0f write", selfMonitor.syscalls_read_rate, selfMonitor.syscalls_write_rate);
+            if (selfMonitor.allocs_tracked) {
+                ImGui::Text("Allocations/s: %.0f", selfMonitor.allocs_rate);
+            } else {
+                ImGui::TextDisabled("Allocations/s: build with TRACK_ALLOC=1");
+            }
+
+            ImGui::SliderFloat("CPU budget (%)", &selfMonitor.cpu_budget, 0.1f, 25.0f, "%.1f");
+            ImGui::SliderFloat("RSS budget (MB)", &selfMonitor.rss_budget_mb, 10.0f, 1024.0f, "%.0f");
+
+            if (!selfMonitor.cpu_history.empty()) {
+                float top = max(*max_element(selfMonitor.cpu_history.begin(), selfMonitor.cpu_history.end()),
+                                selfMonitor.cpu_budget) * 1.2f;
+                ImGui::PlotLines("Own CPU %", selfMonitor.cpu_history.data(), selfMonitor.cpu_history.size(),
+                                 0, nullptr, 0.0f, top, ImVec2(0, 60));
+            }
+
+            ImGui::Separator();
+            {
+            lock_guard<mutex> guard(governor.lock); // shared with the sampler thread
+            ImGui::Text("Collection: %.2f%% of one core", governor.collection_cpu);
+            ImGui::Checkbox("Adapt sampling to budget", &governor.enabled);
+            ImGui::SliderFloat("Collection budget (%)", &governor.cpu_budget, 0.1f, 10.0f, "%.1f");
+            if (ImGui::Checkbox("Idle priority (SCHED_IDLE)", &governor.idle_priority)) {
+                sampler.wake();
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Applies to the sampler thread only; drawing keeps its priority");
+            }
+            if (ImGui::BeginTable("governor", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Collector");
+                ImGui::TableSetupColumn("Interval");
+                ImGui::TableSetupColumn("ms/run");
+                ImGui::TableSetupColumn("CPU %");
+                ImGui::TableHeadersRow();
+                for (const GovernedCollector& c : governor.collectors) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(c.name);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text(c.slowdown > 1 ? "%.1fs (x%d)" : "%.1fs", c.interval, c.slowdown);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.2f", c.cost_ms);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.2f", c.cpu_share);
+                }
+                ImGui::EndTable();
+            }
+            }
+
+            ImGui::Separator();
+            bool adaptive = sampler.adaptive_enabled;
+            if (ImGui::Checkbox("Adaptive sampling", &adaptive)) {
+                sampler.adaptive_enabled = adaptive;
+                sampler.wake();
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Sample faster while a value is changing and back off while it is steady");
+            }
+            if (ImGui::BeginTable("sampling", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                static const char* names[SAMPLE_COUNT] = {"CPU", "Memory", "Disk", "Network",
+                                                          "Sensors", "Task counts", "Processes", "Threads",
+                                                          "PSS/USS", "Disk I/O", "Filesystems",
+                                                          "Pressure", "cgroups", "Command lines"};
+                ImGui::TableSetupColumn("Source");
+                ImGui::TableSetupColumn("Interval");
+                ImGui::TableHeadersRow();
+                for (int i = 0; i < SAMPLE_COUNT; i++) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(names[i]);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%.2fs", sampler.current_interval[i] / 1000.0);
+                }
+                ImGui::EndTable();
+            }
+
+            bool uring = useUring();
+            if (uringUnavailable()) {
+                ImGui::TextDisabled("io_uring process scan: not available on this kernel");
+            } else if (ImGui::Checkbox("io_uring process scan", &uring)) {
+                setUseUring(uring);
+            }
+
+            ImGui::Separator();
+            if (ImGui::BeginTable("selfThreads", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("TID");
+                ImGui::TableSetupColumn("Thread");
+                ImGui::TableSetupColumn("CPU %");
+                ImGui::TableHeadersRow();
+                for (const ThreadCPU& thread : selfMonitor.threads) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%d", thread.tid);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::TextUnformatted(thread.name);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.2f", thread.cpu_usage);
+                }
+                ImGui::EndTable();
+            }
+
+            ImGui::EndTabItem();
+        }
+
         ImGui::EndTabBar();
     }
 
@@ -180,26 +658,86 @@ void systemWindow(const char *id, ImVec2 size, ImVec2 position)
 
 // Global variables for memory window
 static char processFilter[256] = "";
+static bool filterIgnoreCase = false;
+static bool topIO = false;             // only processes doing storage I/O, busiest first
+static vector<SortKey> headerSortKeys; // from the table headers, restored when topIO goes off
+static bool treeView = false;          // processes under their parents, with subtree totals
+static bool treeStale = true;          // processTree hasn't merged the current snapshot
+static bool treeRowsDirty = true;      // processTree.rows need rebuilding
+static ProcessTree processTree;
+static ProcessFilter processFilterProgram; // compiled from processFilter
 static vector<int> selectedProcesses;
+static vector<int> processRows;        // indices into samples.processes that pass the filter
+static ProcessOrder processOrder;      // processRows in table sort order
+static vector<pair<int, long long>> expandedProcesses; // (pid, starttime) of rows showing their threads
+
+// An expanded process in the current table order, with the thread rows under it
+struct ExpandedRow {
+    int rank;                     // position of the process in processOrder.order
+    const ProcessThreads* group;  // nullptr until the sampler has read its threads
+};
+static vector<ExpandedRow> expandedRows;
+
+// Snapshot index of the process at `rank`, in tree or table order
+static int processAt(int rank)
+{
+    return treeView ? processTree.rows[rank].index : processOrder.order[rank];
+}
 
-// Helper function to format bytes
-string formatMemoryBytes(long long bytes) {
-    if (bytes >= 1024LL * 1024 * 1024) {
-        double gb = (double)bytes / (1024.0 * 1024.0 * 1024.0);
-        return to_string((int)round(gb)) + " GB";
-    } else if (bytes >= 1024 * 1024) {
-        double mb = (double)bytes / (1024.0 * 1024.0);
-        return to_string((int)round(mb)) + " MB";
-    } else if (bytes >= 1024) {
-        double kb = (double)bytes / 1024.0;
-        return to_string((int)round(kb)) + " KB";
-    }
-    return to_string(bytes) + " B";
+static long long rssBytes(long long pages)
+{
+    static const long long page_size = sysconf(_SC_PAGESIZE);
+    return pages * page_size;
+}
+
+static bool isExpanded(const Proc& proc)
+{
+    return std::find(expandedProcesses.begin(), expandedProcesses.end(),
+                     make_pair(proc.pid, proc.starttime)) != expandedProcesses.end();
 }
 
+static void toggleExpanded(const Proc& proc)
+{
+    pair<int, long long> key(proc.pid, proc.starttime);
+    auto it = std::find(expandedProcesses.begin(), expandedProcesses.end(), key);
+    if (it != expandedProcesses.end()) {
+        expandedProcesses.erase(it);
+    } else {
+        expandedProcesses.push_back(key);
+    }
+    sampler.setExpanded(expandedProcesses);
+}
+
+// Processes whose smaps_rollup the sampler reads: the visible rows plus the selection
+static vector<pair<int, long long>> memoryWanted;
+static vector<pair<int, long long>> memoryWantedSent;
+
+// "12.3 MB", "-" before the first read, "n/a" when smaps_rollup can't be read
+static const char* formatSmaps(char* buf, size_t size, const ProcessMemory* entry, long long SmapsRollup::*field)
+{
+    if (entry == nullptr || entry->updated < 0.0) return "-";
+    if (!entry->readable) return "n/a";
+    return formatBytes(buf, size, entry->smaps.*field);
+}
+
+static const ProcessThreads* findThreads(const Proc& proc)
+{
+    for (const ProcessThreads& group : samples.threads) {
+        if (group.pid == proc.pid && group.starttime == proc.starttime) return &group;
+    }
+    return nullptr;
+}
+
+// Usage bar labels, re-formatted only when the numbers change
+static CachedLabel ramLabel;
+static CachedLabel swapLabel;
+static CachedLabel diskLabel;
+
 // memoryProcessesWindow, display information for the memory and processes information
 void memoryProcessesWindow(const char *id, ImVec2 size, ImVec2 position)
 {
+    ALLOC_SCOPE("memoryProcessesWindow");
+    PROFILE_SCOPE("memoryProcessesWindow");
     ImGui::Begin(id);
     ImGui::SetWindowSize(id, size);
     ImGui::SetWindowPos(id, position);
@@ -209,29 +747,32 @@ void memoryProcessesWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::Spacing();
 
     // RAM Usage
-    MemoryInfo ramInfo = getMemoryInfo();
+    const MemoryInfo &ramInfo = samples.memory;
     ImGui::Text("Physical Memory (RAM)");
-    ImGui::ProgressBar(ramInfo.percentage / 100.0f, ImVec2(0.0f, 0.0f),
-                      (formatMemoryBytes(ramInfo.used) + " / " + formatMemoryBytes(ramInfo.total) +
-                       " (" + to_string((int)ramInfo.percentage) + "%)").c_str());
+    if (ramLabel.changed(ramInfo.used, ramInfo.total)) {
+        formatUsage(ramLabel.text, sizeof(ramLabel.text), ramInfo.used, ramInfo.total, ramInfo.percentage);
+    }
+    ImGui::ProgressBar(ramInfo.percentage / 100.0f, ImVec2(0.0f, 0.0f), ramLabel.text);
 
     // SWAP Usage
-    MemoryInfo swapInfo = getSwapInfo();
+    const MemoryInfo &swapInfo = samples.swap;
     ImGui::Text("Virtual Memory (SWAP)");
     if (swapInfo.total > 0) {
-        ImGui::ProgressBar(swapInfo.percentage / 100.0f, ImVec2(0.0f, 0.0f),
-                          (formatMemoryBytes(swapInfo.used) + " / " + formatMemoryBytes(swapInfo.total) +
-                           " (" + to_string((int)swapInfo.percentage) + "%)").c_str());
+        if (swapLabel.changed(swapInfo.used, swapInfo.total)) {
+            formatUsage(swapLabel.text, sizeof(swapLabel.text), swapInfo.used, swapInfo.total, swapInfo.percentage);
+        }
+        ImGui::ProgressBar(swapInfo.percentage / 100.0f, ImVec2(0.0f, 0.0f), swapLabel.text);
     } else {
         ImGui::Text("No swap configured");
     }
 
     // Disk Usage
-    DiskInfo diskInfo = getDiskInfo("/");
+    const DiskInfo &diskInfo = samples.disk;
     ImGui::Text("Disk Usage (/)");
-    ImGui::ProgressBar(diskInfo.percentage / 100.0f, ImVec2(0.0f, 0.0f),
-                      (formatMemoryBytes(diskInfo.used) + " / " + formatMemoryBytes(diskInfo.total) +
-                       " (" + to_string((int)diskInfo.percentage) + "%)").c_str());
+    if (diskLabel.changed(diskInfo.used, diskInfo.total)) {
+        formatUsage(diskLabel.text, sizeof(diskLabel.text), diskInfo.used, diskInfo.total, diskInfo.percentage);
+    }
+    ImGui::ProgressBar(diskInfo.percentage / 100.0f, ImVec2(0.0f, 0.0f), diskLabel.text);
 
     ImGui::Spacing();
 
@@ -243,149 +784,271 @@ void memoryProcessesWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::Text("Filter:");
     ImGui::SameLine();
     ImGui::InputText("##filter", processFilter, sizeof(processFilter));
+    ImGui::SameLine();
+    ImGui::Checkbox("Ignore case", &filterIgnoreCase);
+    ImGui::SameLine();
+    bool topIOToggled = ImGui::Checkbox("Top I/O", &topIO);
+    ImGui::SameLine();
+    bool treeToggled = ImGui::Checkbox("Tree", &treeView);
+    ImGui::SameLine();
+    ImGui::TextDisabled("(?)");
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Space-separated terms, all must match:\n"
+                          "  nginx          name contains 'nginx'\n"
+                          "  name~ng name=nginx name!~ng\n"
+                          "  cpu>5 mem>=1.5 pid<1000\n"
+                          "  read>1M write>0 io>10M   bytes/s, K/M/G suffixes\n"
+                          "  state=R state~RD\n"
+                          "  user=www user!=root\n"
+                          "  cmd~job-1234   command line contains 'job-1234'");
+    }
+
+    // Recompile only when the expression changes, not every frame
+    static string compiledFilter;
+    static bool compiledIgnoreCase = false;
+    bool filter_changed = compiledFilter != processFilter || compiledIgnoreCase != filterIgnoreCase || topIOToggled;
+    if (filter_changed) {
+        compiledFilter = processFilter;
+        compiledIgnoreCase = filterIgnoreCase;
+        processFilterProgram.compile(compiledFilter, compiledIgnoreCase);
+        sampler.setCmdlinesWanted(processFilterProgram.usesCmdline());
+    }
+    if (!processFilterProgram.error.empty()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Filter: %s", processFilterProgram.error.c_str());
+    }
 
     ImGui::Spacing();
 
     // Process table
-    if (ImGui::BeginTable("ProcessTable", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
-                         ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable)) {
-
-        ImGui::TableSetupColumn("PID", ImGuiTableColumnFlags_WidthFixed, 80.0f);
-        ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
-        ImGui::TableSetupColumn("State", ImGuiTableColumnFlags_WidthFixed, 60.0f);
-        ImGui::TableSetupColumn("CPU %", ImGuiTableColumnFlags_WidthFixed, 80.0f);
-        ImGui::TableSetupColumn("Memory %", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+    memoryWanted.clear();
+    if (ImGui::BeginTable("ProcessTable", 10, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                         ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable | ImGuiTableFlags_Hideable |
+                         ImGuiTableFlags_Sortable | ImGuiTableFlags_SortMulti)) {
+
+        ImGui::TableSetupColumn("PID", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort, 80.0f, PROC_COL_PID);
+        ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch, -1.0f, PROC_COL_NAME);
+        ImGui::TableSetupColumn("State", ImGuiTableColumnFlags_WidthFixed, 60.0f, PROC_COL_STATE);
+        ImGui::TableSetupColumn("CPU %", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 80.0f, PROC_COL_CPU);
+        ImGui::TableSetupColumn("Memory %", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 80.0f, PROC_COL_MEM);
+        // Read lazily for the rows on screen, so there is nothing to sort by
+        ImGui::TableSetupColumn("PSS", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 80.0f);
+        ImGui::TableSetupColumn("USS", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 80.0f);
+        ImGui::TableSetupColumn("Read/s", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 80.0f, PROC_COL_READ);
+        ImGui::TableSetupColumn("Write/s", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 80.0f, PROC_COL_WRITE);
+        ImGui::TableSetupColumn("Syscalls/s", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 80.0f, PROC_COL_SYSCALLS);
         ImGui::TableHeadersRow();
 
-        vector<Proc> processes = getProcesses();
-        string filterStr = string(processFilter);
-
-        for (size_t i = 0; i < processes.size(); i++) {
-            const Proc& proc = processes[i];
-
-            // Apply filter
-            if (!filterStr.empty() && proc.name.find(filterStr) == string::npos) {
-                continue;
-            }
-
-            ImGui::TableNextRow();
-
-            // PID column
-            ImGui::TableSetColumnIndex(0);
-            bool isSelected = std::find(selectedProcesses.begin(), selectedProcesses.end(), proc.pid) != selectedProcesses.end();
-
-            if (ImGui::Selectable(to_string(proc.pid).c_str(), isSelected, ImGuiSelectableFlags_SpanAllColumns)) {
-                if (ImGui::GetIO().KeyCtrl) {
-                    // Multi-select with Ctrl
-                    if (isSelected) {
-                        selectedProcesses.erase(std::remove(selectedProcesses.begin(), selectedProcesses.end(), proc.pid),
-                                              selectedProcesses.end());
-                    } else {
-                        selectedProcesses.push_back(proc.pid);
-                    }
-                } else {
-                    // Single select
-                    selectedProcesses.clear();
-                    selectedProcesses.push_back(proc.pid);
+        // Shift+click on headers adds secondary sort columns
+        if (ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs()) {
+            if (sortSpecs->SpecsDirty) {
+                vector<SortKey> keys;
+                for (int n = 0; n < sortSpecs->SpecsCount; n++) {
+                    const ImGuiTableColumnSortSpecs& spec = sortSpecs->Specs[n];
+                    keys.push_back({(int)spec.ColumnUserID, spec.SortDirection == ImGuiSortDirection_Descending});
                 }
+                headerSortKeys = keys;
+                if (!topIO) processOrder.setKeys(keys);
+                sortSpecs->SpecsDirty = false;
+                treeRowsDirty = true;
             }
+        }
+        if (topIOToggled) {
+            processOrder.setKeys(topIO ? vector<SortKey>{{PROC_COL_IO, true}} : headerSortKeys);
+        }
 
-            // Name column with anti-flickering
-            ImGui::TableSetColumnIndex(1);
-            static map<int, pair<string, double>> cached_names; // pid -> (name, last_update_time)
-            static double last_name_update = 0.0;
-
-            double current_time = SDL_GetTicks() / 1000.0;
-            string display_name;
-
-            // Update names every 2 seconds to prevent flickering
-            if (current_time - last_name_update > 2.0 || cached_names.find(proc.pid) == cached_names.end()) {
-                display_name = proc.name;
-                cached_names[proc.pid] = make_pair(display_name, current_time);
-                if (proc.pid == 1) last_name_update = current_time;
-            } else {
-                display_name = cached_names[proc.pid].first;
+        // The sampler rescans every 2 seconds, or less often when the governor is
+        // over budget; this also keeps the values from flickering
+        bool snapshot_changed = processesDirty;
+        processesDirty = false;
+        bool cmdlines_changed = cmdlinesDirty && processFilterProgram.usesCmdline();
+        cmdlinesDirty = false;
+
+        // Rebuild the filtered row list only when its inputs change. The sampler
+        // syncs the command line index on its own schedule; an index that lags the
+        // snapshot only delays matching of new processes.
+        if (snapshot_changed || filter_changed || cmdlines_changed) {
+            processFilterProgram.apply(samples.processes, processRows, *samples.cmdlines);
+            if (topIO) {
+                processRows.erase(std::remove_if(processRows.begin(), processRows.end(), [](int r) {
+                    const Proc& proc = samples.processes[r];
+                    return proc.read_rate + proc.write_rate <= 0.0;
+                }), processRows.end());
             }
-            ImGui::Text("%s", display_name.c_str());
+            processOrder.update(samples.processes, processRows);
+        }
 
-            // State column with anti-flickering
-            ImGui::TableSetColumnIndex(2);
-            static map<int, pair<char, double>> cached_states; // pid -> (state, last_update_time)
-            static double last_state_update = 0.0;
+        // The tree follows each snapshot only while shown; turning it on merges against
+        // whatever it last saw. Rows are only ever built from a snapshot it has merged.
+        // Siblings sort by the table keys.
+        if (snapshot_changed) treeStale = true;
+        if (treeView && treeStale) {
+            processTree.update(samples.processes);
+            treeStale = false;
+            treeRowsDirty = true;
+        }
+        if (filter_changed || cmdlines_changed || treeToggled) treeRowsDirty = true;
+        if (treeView && treeRowsDirty) {
+            processTree.buildRows(samples.processes, processRows, processOrder.keys);
+            treeRowsDirty = false;
+        }
 
-            char display_state;
+        // Expanded processes that exited stop being read (the snapshot is in pid order)
+        if (snapshot_changed && !expandedProcesses.empty()) {
+            size_t before = expandedProcesses.size();
+            expandedProcesses.erase(std::remove_if(expandedProcesses.begin(), expandedProcesses.end(),
+                [](const pair<int, long long>& e) {
+                    auto it = std::lower_bound(samples.processes.begin(), samples.processes.end(), e.first,
+                                               [](const Proc& p, int pid) { return p.pid < pid; });
+                    return it == samples.processes.end() || it->pid != e.first || it->starttime != e.second;
+                }), expandedProcesses.end());
+            if (expandedProcesses.size() != before) sampler.setExpanded(expandedProcesses);
+        }
 
-            // Update states every 2 seconds to prevent flickering
-            if (current_time - last_state_update > 2.0 || cached_states.find(proc.pid) == cached_states.end()) {
-                display_state = proc.state;
-                cached_states[proc.pid] = make_pair(display_state, current_time);
-                if (proc.pid == 1) last_state_update = current_time;
-            } else {
-                display_state = cached_states[proc.pid].first;
+        // Thread rows sit right under their process, so the clipper runs over processes
+        // plus threads and needs the rank of every expanded process: sort fully then
+        int processCount = treeView ? (int)processTree.rows.size() : (int)processOrder.order.size();
+        int totalRows = processCount;
+        expandedRows.clear();
+        if (!expandedProcesses.empty()) {
+            if (!treeView) processOrder.ensureSorted(samples.processes, processOrder.order.size());
+            for (int rank = 0; rank < processCount; rank++) {
+                const Proc& proc = samples.processes[processAt(rank)];
+                if (!isExpanded(proc)) continue;
+                const ProcessThreads* group = findThreads(proc);
+                expandedRows.push_back({rank, group});
+                if (group) totalRows += (int)group->threads.size();
             }
-            ImGui::Text("%c", display_state);
-
-            // CPU % column with ultra-stable anti-flickering
-            ImGui::TableSetColumnIndex(3);
-            static map<int, pair<double, double>> cached_cpu; // pid -> (cpu_value, last_update_time)
-            static map<int, double> stable_cpu; // pid -> stable display value
-            static double last_cpu_update = 0.0;
-
-            double cpu_value = 0.0;
-
-            // Update CPU values every 3 seconds for maximum stability
-            if (current_time - last_cpu_update > 3.0 || cached_cpu.find(proc.pid) == cached_cpu.end()) {
-                double raw_cpu = getProcessCPUUsage(proc.pid);
+        }
 
-                // Apply heavy stabilization
-                if (stable_cpu.find(proc.pid) == stable_cpu.end()) {
-                    // First time - use raw value
-                    stable_cpu[proc.pid] = raw_cpu;
-                } else {
-                    // Apply very conservative smoothing to prevent flickering
-                    double current_stable = stable_cpu[proc.pid];
-                    double diff = abs(raw_cpu - current_stable);
-
-                    // Only update if change is significant AND consistent
-                    if (diff > 5.0) {
-                        // Big change: use moderate smoothing
-                        stable_cpu[proc.pid] = 0.3 * raw_cpu + 0.7 * current_stable;
-                    } else if (diff > 1.0) {
-                        // Small change: use very conservative smoothing
-                        stable_cpu[proc.pid] = 0.1 * raw_cpu + 0.9 * current_stable;
+        // Only the rows inside the scroll region are submitted
+        ImGuiListClipper clipper;
+        clipper.Begin(totalRows);
+        while (clipper.Step()) {
+            if (!treeView) processOrder.ensureSorted(samples.processes, clipper.DisplayEnd);
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                // Map the display row to a process rank, or a thread of an expanded one
+                int rank = row;
+                const ThreadInfo* thread = nullptr;
+                for (const ExpandedRow& e : expandedRows) {
+                    int threads = e.group ? (int)e.group->threads.size() : 0;
+                    if (rank <= e.rank) break;
+                    if (rank <= e.rank + threads) {
+                        thread = &e.group->threads[rank - e.rank - 1];
+                        break;
                     }
-                    // Changes < 1% are ignored to prevent flickering
+                    rank -= threads;
                 }
 
-                // Round to whole numbers for maximum stability
-                cpu_value = round(stable_cpu[proc.pid]);
-                cached_cpu[proc.pid] = make_pair(cpu_value, current_time);
+                ImGui::TableNextRow();
+                if (thread) {
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextDisabled("  %d", thread->tid);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("    %s", thread->name.c_str());
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("cpu %d", thread->last_cpu);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%c", thread->state);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.1f", thread->cpu_usage);
+                    continue;
+                }
 
-                if (proc.pid == 1) last_cpu_update = current_time;
-            } else {
-                cpu_value = cached_cpu[proc.pid].first;
-            }
+                const Proc& proc = samples.processes[processAt(rank)];
+                // A collapsed subtree shows its totals in the CPU and memory columns
+                const ProcessTree::Node* node = treeView ? processTree.find(proc.pid) : nullptr;
+                bool collapsed = node && node->collapsed && !node->children.empty();
+
+                // PID column
+                ImGui::TableSetColumnIndex(0);
+                bool isSelected = std::find(selectedProcesses.begin(), selectedProcesses.end(), proc.pid) != selectedProcesses.end();
+
+                char pidLabel[16];
+                snprintf(pidLabel, sizeof(pidLabel), "%d", proc.pid);
+                if (ImGui::Selectable(pidLabel, isSelected, ImGuiSelectableFlags_SpanAllColumns |
+                                                            ImGuiSelectableFlags_AllowItemOverlap)) {
+                    if (ImGui::GetIO().KeyCtrl) {
+                        // Multi-select with Ctrl
+                        if (isSelected) {
+                            selectedProcesses.erase(std::remove(selectedProcesses.begin(), selectedProcesses.end(), proc.pid),
+                                                  selectedProcesses.end());
+                        } else {
+                            selectedProcesses.push_back(proc.pid);
+                        }
+                    } else {
+                        // Single select
+                        selectedProcesses.clear();
+                        selectedProcesses.push_back(proc.pid);
+                    }
+                }
 
-            ImGui::Text("%.0f", cpu_value);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::PushID(proc.pid);
+                if (node) {
+                    ImGui::SetCursorPosX(ImGui::GetCursorPosX() +
+                                         processTree.rows[rank].depth * ImGui::GetStyle().IndentSpacing * 0.5f);
+                    if (!node->children.empty()) {
+                        if (ImGui::SmallButton(node->collapsed ? ">" : "v")) {
+                            processTree.toggleCollapsed(proc.pid);
+                            treeRowsDirty = true;
+                        }
+                        if (ImGui::IsItemHovered()) {
+                            ImGui::SetTooltip(node->collapsed ? "Expand subtree" : "Collapse subtree");
+                        }
+                        ImGui::SameLine();
+                    }
+                }
+                if (ImGui::SmallButton(isExpanded(proc) ? "-" : "+")) {
+                    toggleExpanded(proc);
+                }
+                ImGui::PopID();
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Show threads");
+                }
+                ImGui::SameLine();
+                if (collapsed) {
+                    ImGui::Text("%s (+%d)", proc.name.c_str(), node->subtree_procs - 1);
+                } else {
+                    ImGui::TextUnformatted(proc.name.c_str());
+                }
+                if (node && !node->children.empty() && ImGui::IsItemHovered()) {
+                    char rss[32];
+                    ImGui::SetTooltip("Subtree: %d processes, %d threads\nCPU %.1f%%, RSS %s", node->subtree_procs,
+                                      node->subtree_threads, max(0.0, node->subtree_cpu),
+                                      formatBytes(rss, sizeof(rss), rssBytes(node->subtree_rss)));
+                }
 
-            // Memory % column with anti-flickering
-            ImGui::TableSetColumnIndex(4);
-            static map<int, pair<double, double>> cached_memory; // pid -> (memory_value, last_update_time)
-            static double last_memory_update = 0.0;
-
-            double memory_value = 0.0;
-
-            // Update memory every 2 seconds to prevent flickering
-            if (current_time - last_memory_update > 2.0 || cached_memory.find(proc.pid) == cached_memory.end()) {
-                memory_value = getProcessMemoryUsage(proc.pid);
-                // Round to prevent micro-fluctuations
-                memory_value = round(memory_value * 10.0) / 10.0;
-                cached_memory[proc.pid] = make_pair(memory_value, current_time);
-                if (proc.pid == 1) last_memory_update = current_time;
-            } else {
-                memory_value = cached_memory[proc.pid].first;
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%c", proc.state);
+
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.1f", collapsed ? max(0.0, node->subtree_cpu) : proc.cpu_usage);
+
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.1f", collapsed && samples.memory.total > 0
+                                      ? (double)rssBytes(node->subtree_rss) / samples.memory.total * 100.0
+                                      : proc.mem_usage);
+
+                memoryWanted.push_back(make_pair(proc.pid, proc.starttime));
+                const ProcessMemory* memory = findProcessMemory(samples.process_memory, proc);
+                char bytes[32];
+                ImGui::TableSetColumnIndex(5);
+                ImGui::TextUnformatted(formatSmaps(bytes, sizeof(bytes), memory, &SmapsRollup::pss));
+                ImGui::TableSetColumnIndex(6);
+                ImGui::TextUnformatted(formatSmaps(bytes, sizeof(bytes), memory, &SmapsRollup::uss));
+
+                // "-" where /proc/<pid>/io isn't readable (other users' processes)
+                ImGui::TableSetColumnIndex(7);
+                ImGui::TextUnformatted(proc.has_io ? formatBytes(bytes, sizeof(bytes), (long long)proc.read_rate) : "-");
+                ImGui::TableSetColumnIndex(8);
+                ImGui::TextUnformatted(proc.has_io ? formatBytes(bytes, sizeof(bytes), (long long)proc.write_rate) : "-");
+                ImGui::TableSetColumnIndex(9);
+                if (proc.has_io) {
+                    ImGui::Text("%.0f", proc.syscall_rate);
+                } else {
+                    ImGui::TextUnformatted("-");
+                }
             }
-            ImGui::Text("%.1f", memory_value);
         }
 
         ImGui::EndTable();
@@ -399,6 +1062,42 @@ void memoryProcessesWindow(const char *id, ImVec2 size, ImVec2 position)
         if (ImGui::Button("Clear Selection")) {
             selectedProcesses.clear();
         }
+
+        // Where the memory of the selection really goes; RSS counts shared pages once per process
+        if (ImGui::BeginTable("SelectedMemory", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            static const char* headers[] = {"PID", "RSS", "PSS", "USS", "Shared clean", "Shared dirty", "Swap", "Swap PSS"};
+            static long long SmapsRollup::* const fields[] = {&SmapsRollup::rss, &SmapsRollup::pss, &SmapsRollup::uss,
+                                                              &SmapsRollup::shared_clean, &SmapsRollup::shared_dirty,
+                                                              &SmapsRollup::swap, &SmapsRollup::swap_pss};
+            for (const char* header : headers) {
+                ImGui::TableSetupColumn(header);
+            }
+            ImGui::TableHeadersRow();
+            for (int pid : selectedProcesses) {
+                const Proc* proc = findProcess(pid);
+                if (proc == nullptr) continue;
+                memoryWanted.push_back(make_pair(proc->pid, proc->starttime));
+                const ProcessMemory* memory = findProcessMemory(samples.process_memory, *proc);
+
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%d", pid);
+                char bytes[32];
+                for (int i = 0; i < 7; i++) {
+                    ImGui::TableSetColumnIndex(i + 1);
+                    ImGui::TextUnformatted(formatSmaps(bytes, sizeof(bytes), memory, fields[i]));
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    // Only tell the sampler when the set of rows changed (scrolling, selection, a new scan)
+    std::sort(memoryWanted.begin(), memoryWanted.end());
+    memoryWanted.erase(std::unique(memoryWanted.begin(), memoryWanted.end()), memoryWanted.end());
+    if (memoryWanted != memoryWantedSent) {
+        memoryWantedSent = memoryWanted;
+        sampler.setMemoryWanted(memoryWanted);
     }
 
     ImGui::End();
@@ -410,9 +1109,35 @@ float calculateNetworkProgress(long long bytes) {
     return min(1.0f, (float)bytes / maxBytes);
 }
 
+// Formatted byte counts of one interface, rebuilt only when its counters move
+struct InterfaceLabels {
+    CachedLabel counters;   // keyed on rx_bytes, tx_bytes
+    char rx[32];
+    char tx[32];
+    char rxReceived[48];    // "<rx> received"
+    char txTransmitted[48]; // "<tx> transmitted"
+    char rxUsage[64];       // "<name> RX: <rx>"
+    char txUsage[64];       // "<name> TX: <tx>"
+};
+static vector<InterfaceLabels> interfaceLabels;
+
+static void updateInterfaceLabels(InterfaceLabels& labels, const NetworkInterface& iface)
+{
+    if (!labels.counters.changed(iface.rx_bytes, iface.tx_bytes)) return;
+
+    formatBytes(labels.rx, sizeof(labels.rx), iface.rx_bytes);
+    formatBytes(labels.tx, sizeof(labels.tx), iface.tx_bytes);
+    snprintf(labels.rxReceived, sizeof(labels.rxReceived), "%s received", labels.rx);
+    snprintf(labels.txTransmitted, sizeof(labels.txTransmitted), "%s transmitted", labels.tx);
+    snprintf(labels.rxUsage, sizeof(labels.rxUsage), "%s RX: %s", iface.name.c_str(), labels.rx);
+    snprintf(labels.txUsage, sizeof(labels.txUsage), "%s TX: %s", iface.name.c_str(), labels.tx);
+}
+
 // network, display information network information
 void networkWindow(const char *id, ImVec2 size, ImVec2 position)
 {
+    ALLOC_SCOPE("networkWindow");
+    PROFILE_SCOPE("networkWindow");
     ImGui::Begin(id);
     ImGui::SetWindowSize(id, size);
     ImGui::SetWindowPos(id, position);
@@ -421,7 +1146,15 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
     ImGui::Separator();
     ImGui::Spacing();
 
-    vector<NetworkInterface> interfaces = getNetworkInterfaces();
+    const vector<NetworkInterface> &interfaces = samples.interfaces;
+
+    // Interfaces rarely come and go; when they do, their labels are simply rebuilt
+    if (interfaceLabels.size() != interfaces.size()) {
+        interfaceLabels.assign(interfaces.size(), InterfaceLabels());
+    }
+    for (size_t i = 0; i < interfaces.size(); i++) {
+        updateInterfaceLabels(interfaceLabels[i], interfaces[i]);
+    }
 
     for (const auto& iface : interfaces) {
         ImGui::Text("Interface: %s", iface.name.c_str());
@@ -439,7 +1172,8 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
             // Visual representation with progress bars
             ImGui::Spacing();
 
-            for (const auto& iface : interfaces) {
+            for (size_t i = 0; i < interfaces.size(); i++) {
+                const NetworkInterface& iface = interfaces[i];
                 ImGui::Text("Interface: %s", iface.name.c_str());
 
                 // Calculate progress (scale to 0-2GB range for visualization)
@@ -448,8 +1182,7 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
                 if (progress > 1.0f) progress = 1.0f;
 
                 // Progress bar with current bytes
-                ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f),
-                                 (formatBytes(iface.rx_bytes) + " received").c_str());
+                ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f), interfaceLabels[i].rxReceived);
                 ImGui::Spacing();
             }
 
@@ -470,13 +1203,14 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
                 ImGui::TableSetupColumn("Multicast", ImGuiTableColumnFlags_WidthFixed, 100.0f);
                 ImGui::TableHeadersRow();
 
-                for (const auto& iface : interfaces) {
+                for (size_t i = 0; i < interfaces.size(); i++) {
+                    const NetworkInterface& iface = interfaces[i];
                     ImGui::TableNextRow();
                     ImGui::TableSetColumnIndex(0);
                     ImGui::Text("%s", iface.name.c_str());
 
                     ImGui::TableSetColumnIndex(1);
-                    ImGui::Text("%s", formatBytes(iface.rx_bytes).c_str());
+                    ImGui::TextUnformatted(interfaceLabels[i].rx);
 
                     ImGui::TableSetColumnIndex(2);
                     ImGui::Text("%lld", iface.rx_packets);
@@ -512,7 +1246,8 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
             // Visual representation with progress bars
             ImGui::Spacing();
 
-            for (const auto& iface : interfaces) {
+            for (size_t i = 0; i < interfaces.size(); i++) {
+                const NetworkInterface& iface = interfaces[i];
                 ImGui::Text("Interface: %s", iface.name.c_str());
 
                 // Calculate progress (scale to 0-2GB range for visualization)
@@ -521,8 +1256,7 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
                 if (progress > 1.0f) progress = 1.0f;
 
                 // Progress bar with current bytes
-                ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f),
-                                 (formatBytes(iface.tx_bytes) + " transmitted").c_str());
+                ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f), interfaceLabels[i].txTransmitted);
                 ImGui::Spacing();
             }
 
@@ -543,13 +1277,14 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
                 ImGui::TableSetupColumn("Compressed", ImGuiTableColumnFlags_WidthFixed, 100.0f);
                 ImGui::TableHeadersRow();
 
-                for (const auto& iface : interfaces) {
+                for (size_t i = 0; i < interfaces.size(); i++) {
+                    const NetworkInterface& iface = interfaces[i];
                     ImGui::TableNextRow();
                     ImGui::TableSetColumnIndex(0);
                     ImGui::Text("%s", iface.name.c_str());
 
                     ImGui::TableSetColumnIndex(1);
-                    ImGui::Text("%s", formatBytes(iface.tx_bytes).c_str());
+                    ImGui::TextUnformatted(interfaceLabels[i].tx);
 
                     ImGui::TableSetColumnIndex(2);
                     ImGui::Text("%lld", iface.tx_packets);
@@ -591,28 +1326,220 @@ void networkWindow(const char *id, ImVec2 size, ImVec2 position)
 
     // RX Usage bars
     ImGui::Text("RX (Received):");
-    for (const auto& iface : interfaces) {
-        float progress = calculateNetworkProgress(iface.rx_bytes);
-        string label = iface.name + " RX: " + formatBytes(iface.rx_bytes);
-        ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f), label.c_str());
+    for (size_t i = 0; i < interfaces.size(); i++) {
+        float progress = calculateNetworkProgress(interfaces[i].rx_bytes);
+        ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f), interfaceLabels[i].rxUsage);
     }
 
     ImGui::Spacing();
 
     // TX Usage bars
     ImGui::Text("TX (Transmitted):");
-    for (const auto& iface : interfaces) {
-        float progress = calculateNetworkProgress(iface.tx_bytes);
-        string label = iface.name + " TX: " + formatBytes(iface.tx_bytes);
-        ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f), label.c_str());
+    for (size_t i = 0; i < interfaces.size(); i++) {
+        float progress = calculateNetworkProgress(interfaces[i].tx_bytes);
+        ImGui::ProgressBar(progress, ImVec2(0.0f, 0.0f), interfaceLabels[i].txUsage);
     }
 
     ImGui::End();
 }
 
+// Frame pacing: the loop sleeps until input or a sampler event arrives
+static const int FRAMES_AFTER_INPUT = 3;           // frames ImGui needs to settle hover/active state
+static const double IDLE_REFRESH_INTERVAL = 1.0;   // redraw at least this often (self-monitor, tooltips)
+static const double UNFOCUSED_FRAME_INTERVAL = 0.5;  // new samples draw at most this often when unfocused
+static const int MINIMIZED_WAIT_MS = 1000;
+static double lastFrameTime = 0.0;
+static bool sampleFramePending = false;  // unfocused: new data waiting for its frame
+
+// How long the main loop may block waiting for events before drawing a frame.
+// New samples arrive as events, so this only bounds the wait when nothing happens,
+// or, unfocused, until held-back samples may be drawn.
+static int frameWaitMs(bool focused, const ImGuiIO &io)
+{
+    double now = SDL_GetTicks() / 1000.0;
+    double wait = lastFrameTime + IDLE_REFRESH_INTERVAL - now;
+    if (!focused && sampleFramePending) {
+        wait = min(wait, lastFrameTime + UNFOCUSED_FRAME_INTERVAL - now);
+    }
+    if (io.WantTextInput) {
+        wait = min(wait, 0.4); // keep the text cursor blinking
+    }
+    return (int)ceil(max(0.0, min(wait, 1.0)) * 1000.0); // rounded up so a held frame isn't polled for
+}
+
+#ifdef MONITOR_TRACK_ALLOC
+// Debug overlay for TRACK_ALLOC=1 builds: heap traffic of the previous frame
+static void allocationWindow()
+{
+    ImGui::SetNextWindowSize(ImVec2(360, 0), ImGuiCond_FirstUseEver);
+    ImGui::Begin("== Allocations ==");
+
+    char bytes[32];
+    AllocStats frame = allocLastFrame();
+    AllocTotals totals = allocTotals();
+    ImGui::Text("Last frame: %lld allocs, %s", frame.allocs, formatBytes(bytes, sizeof(bytes), frame.bytes));
+    ImGui::Text("Live heap: %s", formatBytes(bytes, sizeof(bytes), totals.live_bytes));
+    ImGui::Text("Since start: %lld allocs, %lld frees", totals.allocs, totals.frees);
+
+    const AllocStats* scopes;
+    int count = allocLastScopes(&scopes);
+    if (ImGui::BeginTable("allocScopes", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Allocs");
+        ImGui::TableSetupColumn("Bytes");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < count; i++)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(scopes[i].name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%lld", scopes[i].allocs);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::TextUnformatted(formatBytes(bytes, sizeof(bytes), scopes[i].bytes));
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+#endif
+
+// Scope timer overlay: last frame's timeline per thread and rolling percentiles
+static bool showProfiler = false;
+static float profileBudgetMs = 4.0f;
+
+static void profilerWindow()
+{
+    ImGui::SetNextWindowSize(ImVec2(560, 420), ImGuiCond_FirstUseEver);
+    ImGui::Begin("== Profiler ==", &showProfiler);
+
+    const ProfileEvent* events;
+    uint64_t frameStart, frameEnd;
+    int eventCount = profileFrameEvents(&events, &frameStart, &frameEnd);
+    double frameMs = (frameEnd - frameStart) / 1e6;
+    ImGui::Text("Last frame: %.2f ms (F12 toggles this window)", frameMs);
+    ImGui::SliderFloat("Budget per scope (ms)", &profileBudgetMs, 0.1f, 16.0f, "%.1f");
+
+    // Timeline: one lane per nesting level per thread, scaled to the frame. Only
+    // threads with events in the frame get lanes (the sampler, scan workers and
+    // statvfs workers all have rings); past 16 lanes the area scrolls.
+    const int DEPTH_LANES = 4;
+    const float laneHeight = ImGui::GetTextLineHeight() + 4.0f;
+    int threadRow[MAX_PROFILE_THREADS];
+    for (int t = 0; t < MAX_PROFILE_THREADS; t++)
+        threadRow[t] = -1;
+    int rows = 0;
+    for (int i = 0; i < eventCount; i++)
+    {
+        int thread = events[i].thread;
+        if (thread >= 0 && thread < MAX_PROFILE_THREADS && threadRow[thread] < 0)
+            threadRow[thread] = rows++;
+    }
+    int lanes = rows * DEPTH_LANES;
+    ImGui::BeginChild("timelineArea", ImVec2(0, laneHeight * min(max(lanes, 1), 16) + 4.0f));
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = ImGui::GetContentRegionAvail().x;
+    ImDrawList *draw = ImGui::GetWindowDrawList();
+    ImGui::InvisibleButton("timeline", ImVec2(width, laneHeight * max(lanes, 1)));
+    double scale = frameEnd > frameStart ? width / (double)(frameEnd - frameStart) : 0.0;
+    for (int i = 0; i < eventCount; i++)
+    {
+        const ProfileEvent &e = events[i];
+        if (e.thread < 0 || e.thread >= MAX_PROFILE_THREADS || e.end < frameStart)
+            continue;
+        int lane = threadRow[e.thread] * DEPTH_LANES + min(e.depth, DEPTH_LANES - 1);
+        uint64_t start = max(e.start, frameStart);
+        ImVec2 a(origin.x + (float)((start - frameStart) * scale), origin.y + lane * laneHeight);
+        ImVec2 b(origin.x + (float)((e.end - frameStart) * scale), a.y + laneHeight - 1.0f);
+        b.x = max(b.x, a.x + 1.0f);
+        float hue = fmodf(e.scope * 0.13f, 1.0f);
+        draw->AddRectFilled(a, b, ImColor::HSV(hue, 0.55f, 0.75f));
+        const char *name = profileScopeName(e.scope);
+        if (ImGui::CalcTextSize(name).x < b.x - a.x - 4.0f)
+            draw->AddText(ImVec2(a.x + 2.0f, a.y + 2.0f), IM_COL32_BLACK, name);
+        if (ImGui::IsMouseHoveringRect(a, b))
+            ImGui::SetTooltip("%s: %.3f ms", name, (e.end - e.start) / 1e6);
+    }
+    ImGui::EndChild();
+
+    ProfileScopeStats stats[64];
+    int count = profileScopeStats(stats, 64);
+    if (ImGui::BeginTable("profileScopes", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("Calls");
+        ImGui::TableSetupColumn("Last ms");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p95");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < count; i++)
+        {
+            const ProfileScopeStats &st = stats[i];
+            bool over = st.p99 > profileBudgetMs;
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            if (over)
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", st.name);
+            else
+                ImGui::TextUnformatted(st.name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%d", st.last_calls);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.3f", st.last_ms);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%.3f", st.p50);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%.3f", st.p95);
+            ImGui::TableSetColumnIndex(5);
+            ImGui::Text("%.3f", st.p99);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
 // Main code
-int main(int, char **)
+int main(int argc, char **argv)
 {
+    // Command line:
+    //   --bench [frames]   run the collectors headless and print timings
+    //   --profile          open the profiler overlay
+    //   --budget <pct>     CPU budget for the governed collectors (% of one core)
+    //   --idle             sample under SCHED_IDLE (falls back to nice 19)
+    //   --scan-threads <n> extra threads for the process scan, 0 = single-threaded
+    //                      (give it before --bench to benchmark a setting)
+    //   --io-uring         read per-process files in io_uring batches when available
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench") == 0)
+        {
+            return runBenchmark(i + 1 < argc ? atoi(argv[i + 1]) : 100);
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            showProfiler = true;
+        }
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+        {
+            governor.cpu_budget = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--idle") == 0)
+        {
+            governor.idle_priority = true;
+        }
+        else if (strcmp(argv[i], "--scan-threads") == 0 && i + 1 < argc)
+        {
+            setScanThreads(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--io-uring") == 0)
+        {
+            setUseUring(true);
+        }
+    }
+
     // Setup SDL
     // (Some versions of SDL before <2.0.10 appears to have performance/stalling issues on a minority of Windows systems,
     // depending on whether SDL_INIT_GAMECONTROLLER is enabled or disabled.. updating to latest version of SDL is recommended!)
@@ -683,8 +1610,13 @@ int main(int, char **)
     // Initialize CPU measurements for all processes
     initializeCPUMeasurements();
 
+    // Collectors run on their own thread from here on; it wakes the loop with this event
+    Uint32 sampleEvent = SDL_RegisterEvents(1);
+    sampler.start(&governor, sampleEvent);
+
     // Main loop
     bool done = false;
+    int framesToRender = FRAMES_AFTER_INPUT;
     while (!done)
     {
         // Poll and handle events (inputs, window resize, etc.)
@@ -692,17 +1624,61 @@ int main(int, char **)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+        //
+        // Instead of spinning at vsync, block until an event arrives or the next data is due.
+        // Unfocused windows redraw at a low rate; minimized or hidden ones don't draw at all.
+        Uint32 windowFlags = SDL_GetWindowFlags(window);
+        bool minimized = (windowFlags & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN)) != 0;
+        bool focused = (windowFlags & SDL_WINDOW_INPUT_FOCUS) != 0;
+        sampler.setPaused(minimized); // nobody is looking, so don't collect
+
         SDL_Event event;
-        while (SDL_PollEvent(&event))
+        bool haveEvent;
+        if (minimized) {
+            haveEvent = SDL_WaitEventTimeout(&event, MINIMIZED_WAIT_MS) != 0;
+        } else if (framesToRender > 0) {
+            haveEvent = SDL_PollEvent(&event) != 0;
+        } else {
+            int waitMs = frameWaitMs(focused, io);
+            haveEvent = waitMs > 0 ? SDL_WaitEventTimeout(&event, waitMs) != 0 : SDL_PollEvent(&event) != 0;
+        }
+
+        while (haveEvent)
         {
             ImGui_ImplSDL2_ProcessEvent(&event);
             if (event.type == SDL_QUIT)
                 done = true;
             if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
                 done = true;
+            if (event.type == sampleEvent) {
+                // New data needs one frame, not the input settle; unfocused it waits its turn
+                if (focused)
+                    framesToRender = max(framesToRender, 1);
+                else
+                    sampleFramePending = true;
+            }
+            else
+                framesToRender = FRAMES_AFTER_INPUT;
+            haveEvent = SDL_PollEvent(&event) != 0;
         }
 
-        // Start the Dear ImGui frame
+        if (SDL_GetWindowFlags(window) & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN))
+            continue;
+        // Unfocused and without input, nothing draws before UNFOCUSED_FRAME_INTERVAL is up
+        if (!focused && framesToRender == 0 && SDL_GetTicks() / 1000.0 < lastFrameTime + UNFOCUSED_FRAME_INTERVAL)
+            continue;
+        sampleFramePending = false;
+        if (framesToRender > 0)
+            framesToRender--;
+        lastFrameTime = SDL_GetTicks() / 1000.0;
+
+        // Start the Dear ImGui frame; last frame's temporaries are released with it
+        profileFrameBegin();
+        resetFrameArena();
+        sampler.read(samples, sampleChanged);
+        if (sampleChanged[SAMPLE_PROCESSES]) processesDirty = true;
+        if (sampleChanged[SAMPLE_CMDLINES]) cmdlinesDirty = true;
+        updateGraphs();
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplSDL2_NewFrame(window);
         ImGui::NewFrame();
@@ -720,18 +1696,31 @@ int main(int, char **)
             networkWindow("== Network ==",
                           ImVec2(mainDisplay.x - 20, (mainDisplay.y / 2) - 40),
                           ImVec2(10, (mainDisplay.y / 2) + 50));
+#ifdef MONITOR_TRACK_ALLOC
+            allocationWindow();
+#endif
+            if (ImGui::IsKeyPressed(SDL_SCANCODE_F12, false))
+                showProfiler = !showProfiler;
+            if (showProfiler)
+                profilerWindow();
         }
 
-        // Rendering
-        ImGui::Render();
-        glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-        glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        SDL_GL_SwapWindow(window);
+        // Rendering (includes the vsync wait in SwapWindow)
+        {
+            PROFILE_SCOPE("render");
+            ImGui::Render();
+            glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+            glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            SDL_GL_SwapWindow(window);
+        }
+        ALLOC_FRAME_END();
+        profileFrameEnd();
     }
 
     // Cleanup
+    sampler.stop();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -1,33 +1,38 @@
 #include "header.h"
 #include <sstream>
+#include <string.h>
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <unistd.h>
 #include <ctime>
 #include <vector>
 #include <cmath>
 #include <sys/times.h>
 
+// Value (in kB) of a "Key:   value kB" line in a /proc/meminfo buffer, or 0
+static long long meminfoValue(const char* buf, const char* key)
+{
+    size_t key_len = strlen(key);
+    for (const char* line = buf; line && *line; line = strchr(line, '\n')) {
+        if (*line == '\n') line++;
+        if (strncmp(line, key, key_len) == 0) {
+            return strtoll(line + key_len, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
 // Get memory information from /proc/meminfo
 MemoryInfo getMemoryInfo()
 {
+    PROFILE_SCOPE("getMemoryInfo");
     MemoryInfo info = {0, 0, 0, 0.0};
-    ifstream file("/proc/meminfo");
-    string line;
+    char buf[4096];
 
-    while (getline(file, line)) {
-        istringstream iss(line);
-        string key;
-        long long value;
-        string unit;
-
-        if (iss >> key >> value >> unit) {
-            if (key == "MemTotal:") {
-                info.total = value * 1024; // Convert KB to bytes
-            } else if (key == "MemAvailable:") {
-                info.available = value * 1024;
-            }
-        }
+    if (readProcFile("/proc/meminfo", buf, sizeof(buf)) > 0) {
+        info.total = meminfoValue(buf, "MemTotal:") * 1024; // Convert KB to bytes
+        info.available = meminfoValue(buf, "MemAvailable:") * 1024;
     }
 
     info.used = info.total - info.available;
@@ -41,27 +46,15 @@ MemoryInfo getMemoryInfo()
 // Get swap information from /proc/meminfo
 MemoryInfo getSwapInfo()
 {
+    PROFILE_SCOPE("getSwapInfo");
     MemoryInfo info = {0, 0, 0, 0.0};
-    ifstream file("/proc/meminfo");
-    string line;
-    long long swapFree = 0;
-
-    while (getline(file, line)) {
-        istringstream iss(line);
-        string key;
-        long long value;
-        string unit;
-
-        if (iss >> key >> value >> unit) {
-            if (key == "SwapTotal:") {
-                info.total = value * 1024; // Convert KB to bytes
-            } else if (key == "SwapFree:") {
-                swapFree = value * 1024;
-            }
-        }
+    char buf[4096];
+
+    if (readProcFile("/proc/meminfo", buf, sizeof(buf)) > 0) {
+        info.total = meminfoValue(buf, "SwapTotal:") * 1024; // Convert KB to bytes
+        info.available = meminfoValue(buf, "SwapFree:") * 1024;
     }
 
-    info.available = swapFree;
     info.used = info.total - info.available;
     if (info.total > 0) {
         info.percentage = (double)info.used / info.total * 100.0;
@@ -73,6 +66,7 @@ MemoryInfo getSwapInfo()
 // Get disk information using statvfs
 DiskInfo getDiskInfo(const string& path)
 {
+    PROFILE_SCOPE("getDiskInfo");
     DiskInfo info = {0, 0, 0, 0.0};
     struct statvfs stat;
 
@@ -97,74 +91,305 @@ DiskInfo getDiskInfo(const string& path)
     return info;
 }
 
-// Get list of processes from /proc
-vector<Proc> getProcesses()
+// Parse one /proc/<pid>/stat line into `proc`.
+// comm can contain spaces and parentheses, so fields are located from the last ')'
+static bool parseProcStat(const char* line, Proc& proc)
 {
-    vector<Proc> processes;
-    DIR* proc_dir = opendir("/proc");
-    if (!proc_dir) return processes;
+    const char* first_paren = strchr(line, '(');
+    const char* last_paren = strrchr(line, ')');
+    if (first_paren == nullptr || last_paren == nullptr || last_paren < first_paren) {
+        return false;
+    }
 
-    struct dirent* entry;
-    while ((entry = readdir(proc_dir)) != nullptr) {
-        // Check if directory name is a number (PID)
-        if (strspn(entry->d_name, "0123456789") == strlen(entry->d_name)) {
-            int pid = atoi(entry->d_name);
+    proc.name.assign(first_paren + 1, last_paren - first_paren - 1);
 
-            // Read process stat file
-            string stat_path = "/proc/" + string(entry->d_name) + "/stat";
-            ifstream stat_file(stat_path);
+    // Fields after comm start at field 3 (state); we need up to field 24 (rss)
+    long long fields[25] = {0};
+    const char* p = last_paren + 1;
+    while (*p == ' ') p++;
+    proc.state = *p;
 
-            if (stat_file.is_open()) {
-                Proc proc;
-                proc.pid = pid;
+    int field = 3;
+    while (*p && field < 24) {
+        while (*p && *p != ' ') p++;
+        while (*p == ' ') p++;
+        field++;
+        fields[field] = strtoll(p, nullptr, 10);
+    }
+    if (field < 24) return false;
+
+    proc.ppid = (int)fields[4];
+    proc.utime = fields[14];
+    proc.stime = fields[15];
+    proc.num_threads = (int)fields[20];
+    proc.starttime = fields[22];
+    proc.vsize = fields[23];
+    proc.rss = fields[24];
+    return true;
+}
 
-                string line;
-                getline(stat_file, line);
+// Sum of all jiffies on the aggregate "cpu" line of /proc/stat
+long long readTotalCPUTime()
+{
+    CPUStats s = getCPUStats();
+    return s.user + s.nice + s.system + s.idle + s.iowait + s.irq + s.softirq + s.steal;
+}
 
-                // Parse stat file
-                istringstream iss(line);
-                string pid_str, comm, state_str;
-                iss >> pid_str >> comm >> state_str;
-
-                // Remove parentheses from command name
-                if (comm.length() > 2) {
-                    proc.name = comm.substr(1, comm.length() - 2);
-                } else {
-                    proc.name = comm;
-                }
+// Per-pid values remembered between scans, sorted by pid
+struct PidState {
+    int pid;
+    long long starttime; // a reused pid is a different process
+    long long cpu_time;  // utime + stime
+    long long read_bytes;
+    long long write_bytes;
+    long long syscalls;  // syscr + syscw
+};
+
+static bool pidStateLess(const PidState& state, int pid)
+{
+    return state.pid < pid;
+}
 
-                proc.state = state_str[0];
+static const size_t SCAN_CHUNK = URING_BATCH;  // pids per chunk a scan thread claims
+static const size_t PARALLEL_SCAN_MIN = 2048;  // below this many pids the scan stays inline
 
-                // Skip to the fields we need (vsize and rss are at positions 23 and 24)
-                string temp;
-                for (int i = 0; i < 20; i++) {
-                    iss >> temp;
-                }
-                iss >> proc.vsize >> proc.rss;
+// Storage-level I/O counters from a /proc/<pid>/io buffer; has_io stays false if
+// it couldn't be read (other users' processes need ptrace access, as for smaps)
+static void parseProcIo(const char* buf, ssize_t len, Proc& proc)
+{
+    proc.has_io = len > 0;
+    if (!proc.has_io) {
+        proc.read_bytes = proc.write_bytes = proc.syscr = proc.syscw = 0;
+        return;
+    }
+    proc.syscr = meminfoValue(buf, "syscr:");
+    proc.syscw = meminfoValue(buf, "syscw:");
+    proc.read_bytes = meminfoValue(buf, "read_bytes:");
+    proc.write_bytes = meminfoValue(buf, "write_bytes:");
+}
 
-                // Skip to utime and stime (positions 14 and 15 from start)
-                istringstream iss2(line);
-                for (int i = 0; i < 13; i++) {
-                    iss2 >> temp;
-                }
-                iss2 >> proc.utime >> proc.stime;
+// Read /proc/<pid>/stat, io and the owner of one process into `proc`; false if it
+// exited meanwhile. Runs on the scan threads, so it must not touch shared state.
+static bool readProcess(int pid, Proc& proc)
+{
+    // Relative to the shared /proc fd: "1234/stat" instead of a full path walk
+    char path[32];
+    pidPath(path, pid, "stat");
+    char line[1024];
+    if (readProcFileAt(procFd(), path, line, sizeof(line)) <= 0) {
+        return false;
+    }
+
+    proc.pid = pid;
+    if (!parseProcStat(line, proc)) {
+        return false;
+    }
+
+    pidPath(path, pid, "io");
+    parseProcIo(line, readProcFileAt(procFd(), path, line, sizeof(line)), proc);
 
-                processes.push_back(proc);
+    // The /proc/<pid> directory is owned by the process' effective uid
+    struct stat st;
+    pidPath(path, pid, nullptr);
+    proc.uid = (fstatat(procFd(), path, &st, 0) == 0) ? st.st_uid : (uid_t)-1;
+    return true;
+}
+
+// Two files per pid (stat, io) go into one io_uring batch
+static const size_t URING_PIDS = URING_BATCH / 2;
+
+// Buffers for one io_uring batch of the process scan, one set per scanning thread
+struct ProcReadBatch {
+    UringRead reads[URING_BATCH];
+    char paths[URING_BATCH][32];
+    char dirs[URING_PIDS][32];
+    char lines[URING_PIDS][1024];
+    char io[URING_PIDS][512];
+};
+
+// Read `n` pids into rows[first..], growing `rows` as needed; returns how many
+// were read. Goes through io_uring when it is on, else one pid at a time.
+static size_t readProcesses(const int* pids, size_t n, vector<Proc>& rows, size_t first)
+{
+    size_t count = first;
+    size_t done = 0;
+    while (useUring() && done < n) {
+        static thread_local unique_ptr<ProcReadBatch> batch;
+        if (!batch) batch.reset(new ProcReadBatch());
+
+        size_t m = min(URING_PIDS, n - done);
+        for (size_t i = 0; i < m; i++) {
+            int pid = pids[done + i];
+            UringRead& stat = batch->reads[2 * i];
+            UringRead& io = batch->reads[2 * i + 1];
+            pidPath(batch->paths[2 * i], pid, "stat");
+            pidPath(batch->paths[2 * i + 1], pid, "io");
+            pidPath(batch->dirs[i], pid, nullptr);
+            stat.dir_fd = io.dir_fd = procFd();
+            stat.path = batch->paths[2 * i];
+            stat.buf = batch->lines[i];
+            stat.size = sizeof(batch->lines[i]);
+            stat.stat_path = batch->dirs[i];
+            io.path = batch->paths[2 * i + 1];
+            io.buf = batch->io[i];
+            io.size = sizeof(batch->io[i]);
+            io.stat_path = nullptr;
+        }
+        if (!uringReadBatch(batch->reads, (int)(2 * m))) break;
+
+        for (size_t i = 0; i < m; i++) {
+            const UringRead& stat = batch->reads[2 * i];
+            const UringRead& io = batch->reads[2 * i + 1];
+            if (stat.length <= 0) continue;
+            if (count == rows.size()) {
+                rows.emplace_back();
             }
+            Proc& proc = rows[count];
+            proc.pid = pids[done + i];
+            if (!parseProcStat(stat.buf, proc)) continue;
+            parseProcIo(io.buf, io.length, proc);
+            proc.uid = stat.stx.stx_uid;
+            count++;
         }
+        done += m;
     }
 
-    closedir(proc_dir);
+    // Synchronous path, also for whatever is left if io_uring gave up midway
+    for (size_t i = done; i < n; i++) {
+        if (count == rows.size()) {
+            rows.emplace_back();
+        }
+        if (readProcess(pids[i], rows[count])) {
+            count++;
+        }
+    }
+    return count - first;
+}
+
+// Get list of processes from /proc into `processes`, reusing its storage.
+// CPU% and memory% are computed here in one pass for every process, against the
+// previous scan, so callers never have to re-read per-pid files to display them.
+// On big hosts the per-pid reads are split across a WorkerPool: each chunk of
+// pids fills its own row buffer, and the buffers are merged in chunk order
+// afterwards, so no lock is taken and the result stays in pid order.
+void getProcesses(vector<Proc>& processes, double* worker_cpu)
+{
+    ALLOC_SCOPE("getProcesses");
+    PROFILE_SCOPE("getProcesses");
+    static vector<PidState> prev_states;
+    static vector<PidState> states;
+    static long long prev_total_time = 0;
+    static uint64_t prev_scan_ns = 0;
+    static vector<int> pids;
+    static vector<vector<Proc>> chunk_rows;   // kept between scans for their string buffers
+    static vector<size_t> chunk_counts;
+    static WorkerPool pool;
+
+    // Rows are overwritten in place so long names (kernel workers) keep their
+    // string buffers from the previous scan instead of reallocating
+    size_t count = 0;
+
+    // Our own listing fd, since getdents64 moves its position
+    static int proc_dir = openDirFd("/proc");
+    if (!listNumericEntries(proc_dir, pids)) {
+        processes.clear();
+        return;
+    }
+
+    long long total_time = readTotalCPUTime();
+    long long total_diff = total_time - prev_total_time;
+    uint64_t scan_ns = profileNow();
+    double elapsed = prev_scan_ns > 0 ? (scan_ns - prev_scan_ns) / 1e9 : 0.0;
+    MemoryInfo memInfo = getMemoryInfo();
+    long long page_size = sysconf(_SC_PAGESIZE);
+
+    int threads = pids.size() >= PARALLEL_SCAN_MIN ? scanThreads() : 0;
+    if (threads == 0) {
+        for (size_t begin = 0; begin < pids.size(); begin += SCAN_CHUNK) {
+            size_t n = min(SCAN_CHUNK, pids.size() - begin);
+            count += readProcesses(&pids[begin], n, processes, count);
+        }
+    } else {
+        pool.resize(threads);
+        size_t chunks = (pids.size() + SCAN_CHUNK - 1) / SCAN_CHUNK;
+        if (chunk_rows.size() < chunks) chunk_rows.resize(chunks);
+        chunk_counts.assign(chunks, 0);
+
+        double cpu = pool.parallelFor((int)chunks, [](int chunk) {
+            PROFILE_SCOPE("getProcesses chunk");
+            size_t begin = chunk * SCAN_CHUNK;
+            size_t n = min(SCAN_CHUNK, pids.size() - begin);
+            chunk_counts[chunk] = readProcesses(&pids[begin], n, chunk_rows[chunk], 0);
+        });
+        if (worker_cpu != nullptr) *worker_cpu += cpu;
+
+        // Swapping rather than copying hands each string buffer back to a chunk for next time
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            vector<Proc>& rows = chunk_rows[chunk];
+            for (size_t i = 0; i < chunk_counts[chunk]; i++) {
+                if (count == processes.size()) {
+                    processes.emplace_back();
+                }
+                swap(processes[count], rows[i]);
+                count++;
+            }
+        }
+    }
+    processes.resize(count);
+
+    states.clear();
+    for (Proc& proc : processes) {
+        long long cpu_time = proc.utime + proc.stime;
+        long long syscalls = proc.syscr + proc.syscw;
+        states.push_back({proc.pid, proc.starttime, cpu_time, proc.read_bytes, proc.write_bytes, syscalls});
+
+        // Same formula as top: process jiffies over all-CPU jiffies
+        proc.cpu_usage = 0.0;
+        proc.read_rate = proc.write_rate = proc.syscall_rate = 0.0;
+        auto prev = lower_bound(prev_states.begin(), prev_states.end(), proc.pid, pidStateLess);
+        // Deltas only against the same process; a reused pid starts over like a new one
+        bool known = prev != prev_states.end() && prev->pid == proc.pid && prev->starttime == proc.starttime;
+        if (known && prev_total_time > 0 && total_diff > 0) {
+            proc.cpu_usage = (double)(cpu_time - prev->cpu_time) / total_diff * 100.0;
+            if (proc.cpu_usage < 0) proc.cpu_usage = 0.0;
+        }
+
+        // I/O rates over wall time
+        if (known && proc.has_io && elapsed > 0.0) {
+            proc.read_rate = max(0.0, (proc.read_bytes - prev->read_bytes) / elapsed);
+            proc.write_rate = max(0.0, (proc.write_bytes - prev->write_bytes) / elapsed);
+            proc.syscall_rate = max(0.0, (syscalls - prev->syscalls) / elapsed);
+        }
+
+        proc.mem_usage = 0.0;
+        if (memInfo.total > 0) {
+            proc.mem_usage = (double)(proc.rss * page_size) / memInfo.total * 100.0;
+        }
+    }
+
+    // /proc lists pids in ascending order; sort just in case so lookups stay valid
+    if (!is_sorted(states.begin(), states.end(), [](const PidState& a, const PidState& b) { return a.pid < b.pid; })) {
+        sort(states.begin(), states.end(), [](const PidState& a, const PidState& b) { return a.pid < b.pid; });
+    }
+
+    // Exited pids drop out of the table here
+    prev_states.swap(states);
+    prev_total_time = total_time;
+    prev_scan_ns = scan_ns;
+}
+
+vector<Proc> getProcesses()
+{
+    vector<Proc> processes;
+    getProcesses(processes);
     return processes;
 }
 
 // Initialize CPU measurements for all processes (call this once at startup)
 void initializeCPUMeasurements()
 {
-    vector<Proc> processes = getProcesses();
-    for (const auto& proc : processes) {
-        getProcessCPUUsage(proc.pid); // Initialize measurement
-    }
+    // The first scan only records baselines for the next one
+    getProcesses();
 }
 
 // Get CPU usage for a specific process - NEW ACCURATE METHOD
@@ -297,3 +522,91 @@ double getProcessMemoryUsage(int pid)
 
     return 0.0;
 }
+
+// Proportional memory of one process from /proc/<pid>/smaps_rollup (Linux 4.14+).
+// The kernel walks every mapping to produce it, so this is read only on demand.
+// Needs ptrace read access, i.e. fails for other users' processes unless root.
+bool readSmapsRollup(int pid, SmapsRollup& out)
+{
+    char path[32];
+    pidPath(path, pid, "smaps_rollup");
+    char buf[2048];
+    if (readProcFileAt(procFd(), path, buf, sizeof(buf)) <= 0) {
+        return false;
+    }
+
+    // Skip the "<range> [rollup]" header so every key starts a line
+    const char* body = strchr(buf, '\n');
+    if (body == nullptr) return false;
+    out.rss = meminfoValue(body, "Rss:") * 1024;
+    out.pss = meminfoValue(body, "Pss:") * 1024;
+    out.shared_clean = meminfoValue(body, "Shared_Clean:") * 1024;
+    out.shared_dirty = meminfoValue(body, "Shared_Dirty:") * 1024;
+    out.uss = (meminfoValue(body, "Private_Clean:") + meminfoValue(body, "Private_Dirty:")) * 1024;
+    out.swap = meminfoValue(body, "Swap:") * 1024;
+    out.swap_pss = meminfoValue(body, "SwapPss:") * 1024;
+    return true;
+}
+
+static const double SMAPS_MAX_AGE = 5.0;          // seconds before an entry is read again
+static const uint64_t SMAPS_BUDGET_NS = 10000000; // reading time per update()
+
+static bool processMemoryLess(const ProcessMemory& entry, int pid)
+{
+    return entry.pid < pid;
+}
+
+bool ProcessMemoryCache::update(vector<pair<int, long long>> wanted, double now)
+{
+    PROFILE_SCOPE("ProcessMemoryCache::update");
+    sort(wanted.begin(), wanted.end());
+    wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+
+    // Carry over what is still wanted; a different starttime is a new process
+    bool changed = wanted.size() != entries.size();
+    next.clear();
+    for (const pair<int, long long>& w : wanted) {
+        auto it = lower_bound(entries.begin(), entries.end(), w.first, processMemoryLess);
+        if (it != entries.end() && it->pid == w.first && it->starttime == w.second) {
+            next.push_back(*it);
+        } else {
+            ProcessMemory entry;
+            entry.pid = w.first;
+            entry.starttime = w.second;
+            entry.readable = false;
+            entry.updated = -1.0;
+            entry.smaps = SmapsRollup();
+            next.push_back(entry);
+            changed = true;
+        }
+    }
+    entries.swap(next);
+
+    // Oldest first (never read sorts first), until the time budget is spent
+    stale.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].updated < 0.0 || now - entries[i].updated >= SMAPS_MAX_AGE) {
+            stale.push_back((int)i);
+        }
+    }
+    sort(stale.begin(), stale.end(), [this](int a, int b) { return entries[a].updated < entries[b].updated; });
+
+    uint64_t start = profileNow();
+    for (int i : stale) {
+        if (profileNow() - start >= SMAPS_BUDGET_NS) break;
+        ProcessMemory& entry = entries[i];
+        entry.readable = readSmapsRollup(entry.pid, entry.smaps);
+        entry.updated = now;
+        changed = true;
+    }
+    return changed;
+}
+
+const ProcessMemory* findProcessMemory(const vector<ProcessMemory>& entries, const Proc& proc)
+{
+    auto it = lower_bound(entries.begin(), entries.end(), proc.pid, processMemoryLess);
+    if (it != entries.end() && it->pid == proc.pid && it->starttime == proc.starttime) {
+        return &*it;
+    }
+    return nullptr;
+}
@@ -0,0 +1,280 @@
+#include "header.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+
+// Capacity and inode usage of every mounted filesystem.
+// The mount table is reread only when the kernel flags /proc/self/mountinfo
+// (the sampler polls it for POLLPRI). statvfs() on a dead NFS or FUSE mount can
+// block indefinitely and can't be interrupted, so it never runs on the sampler
+// thread: a worker makes the calls, each probe has its own deadline, and a mount
+// whose probe is overdue shows as not responding and isn't probed again until
+// that call returns.
+
+static uint64_t monotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Kernel and virtual filesystems with no capacity to speak of. autofs must never
+// be probed: a statvfs() on it would trigger the automount.
+static const char* const pseudoFilesystems[] = {
+    "autofs", "binfmt_misc", "bpf", "cgroup", "cgroup2", "configfs", "debugfs", "devpts",
+    "efivarfs", "fusectl", "hugetlbfs", "mqueue", "nsfs", "proc", "pstore", "rpc_pipefs",
+    "securityfs", "selinuxfs", "sysfs", "tracefs",
+};
+
+static bool isPseudoFilesystem(const char* type, size_t len)
+{
+    for (const char* pseudo : pseudoFilesystems) {
+        if (strlen(pseudo) == len && memcmp(pseudo, type, len) == 0) return true;
+    }
+    return false;
+}
+
+// Next space-separated field of a mountinfo line; advances `p` past it
+static const char* nextField(const char*& p, size_t& len)
+{
+    while (*p == ' ') p++;
+    const char* start = p;
+    while (*p && *p != ' ' && *p != '\n') p++;
+    len = p - start;
+    return start;
+}
+
+// Mount points and sources escape space, tab, newline and backslash as \ooo
+static void unescapeField(string& out, const char* field, size_t len)
+{
+    out.clear();
+    for (size_t i = 0; i < len; i++) {
+        if (field[i] == '\\' && i + 3 < len && field[i + 1] >= '0' && field[i + 1] <= '3') {
+            out += (char)((field[i + 1] - '0') * 64 + (field[i + 2] - '0') * 8 + (field[i + 3] - '0'));
+            i += 3;
+        } else {
+            out += field[i];
+        }
+    }
+}
+
+void StatvfsWorker::run(shared_ptr<StatvfsWorker> worker)
+{
+    pthread_setname_np(pthread_self(), "statvfs");
+    unique_lock<mutex> guard(worker->lock);
+    while (true) {
+        worker->cv.wait(guard, [&] { return worker->abandoned || !worker->queue.empty(); });
+        if (worker->abandoned) return;
+
+        shared_ptr<StatvfsProbe> probe = worker->queue.front();
+        worker->queue.erase(worker->queue.begin());
+        worker->current = probe;
+        probe->started_ms = monotonicMs();
+        guard.unlock();
+
+        // This is the call that may never come back
+        probe->ok = statvfs(probe->path.c_str(), &probe->result) == 0;
+        probe->done = true;
+
+        guard.lock();
+        worker->current.reset();
+    }
+}
+
+FilesystemMonitor::~FilesystemMonitor()
+{
+    // The worker is detached and may be stuck; it only holds its own state
+    if (worker) {
+        {
+            lock_guard<mutex> guard(worker->lock);
+            worker->abandoned = true;
+        }
+        worker->cv.notify_one();
+    }
+    if (mountinfo_fd >= 0) close(mountinfo_fd);
+}
+
+void FilesystemMonitor::startWorker()
+{
+    worker = make_shared<StatvfsWorker>();
+    thread(&StatvfsWorker::run, worker).detach();
+}
+
+void FilesystemMonitor::readMounts()
+{
+    PROFILE_SCOPE("mountinfo");
+    if (buf.empty()) buf.resize(16384);
+    // Thousands of mounts are common on container hosts; grow until the table fits
+    size_t len;
+    while (true) {
+        len = 0;
+        while (len < buf.size() - 1) {
+            ssize_t n = pread(mountinfo_fd, buf.data() + len, buf.size() - 1 - len, len);
+            if (n <= 0) break;
+            len += n;
+        }
+        if (len < buf.size() - 1) break;
+        buf.resize(buf.size() * 2);
+    }
+    buf[len] = '\0';
+
+    // "36 35 98:0 /root /mnt/point rw,noatime master:1 - ext4 /dev/sda1 rw"
+    vector<Mount> next;
+    string mount_point;
+    const char* p = buf.data();
+    while (*p) {
+        const char* line = p;
+        while (*p && *p != '\n') p++;
+        const char* end = p;
+        if (*p == '\n') p++;
+
+        const char* q = line;
+        size_t len_id, len_parent, len_device, len_root, len_point;
+        const char* id = nextField(q, len_id);
+        nextField(q, len_parent);
+        const char* device = nextField(q, len_device);
+        nextField(q, len_root);
+        const char* point = nextField(q, len_point);
+        // Optional fields run up to the " - " separator
+        const char* separator = strstr(q, " - ");
+        if (separator == nullptr || separator > end || len_id == 0) continue;
+        q = separator + 3;
+        size_t len_type, len_source;
+        const char* type = nextField(q, len_type);
+        const char* source = nextField(q, len_source);
+        if (isPseudoFilesystem(type, len_type)) continue;
+
+        // A mount on top of another hides it; only the later one is reachable
+        unescapeField(mount_point, point, len_point);
+        next.erase(remove_if(next.begin(), next.end(),
+                             [&](const Mount& m) { return m.info.mount_point == mount_point; }),
+                   next.end());
+
+        // Bind mounts show the same filesystem again; df keeps the first one too
+        char device_id[16];
+        snprintf(device_id, sizeof(device_id), "%.*s", (int)len_device, device);
+        bool duplicate = false;
+        for (const Mount& m : next) {
+            if (strcmp(m.device, device_id) == 0) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate) continue;
+
+        int mount_id = atoi(id);
+
+        // A mount that is still there keeps its numbers and any probe in flight
+        auto it = find_if(mounts.begin(), mounts.end(), [&](const Mount& m) {
+            return m.info.mount_id == mount_id && m.info.mount_point == mount_point;
+        });
+        if (it != mounts.end()) {
+            next.push_back(move(*it));
+            continue;
+        }
+
+        Mount m;
+        m.info.mount_id = mount_id;
+        m.info.mount_point = mount_point;
+        unescapeField(m.info.source, source, len_source);
+        m.info.fstype.assign(type, len_type);
+        m.info.state = FS_PENDING;
+        m.info.total = m.info.used = m.info.available = 0;
+        m.info.percentage = 0.0;
+        m.info.inodes_total = m.info.inodes_used = 0;
+        m.info.inodes_percentage = 0.0;
+        memcpy(m.device, device_id, sizeof(m.device));
+        m.last_probe_ms = 0;
+        next.push_back(move(m));
+    }
+    mounts.swap(next);
+}
+
+bool FilesystemMonitor::update(uint64_t now_ms)
+{
+    bool changed = false;
+    if (mountinfo_fd < 0) {
+        mountinfo_fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+        if (mountinfo_fd < 0) return false;
+        mounts_changed = true;
+    }
+    if (mounts_changed) {
+        mounts_changed = false;
+        readMounts();
+        changed = true;
+    }
+    if (!worker) startWorker();
+
+    vector<shared_ptr<StatvfsProbe>> due;
+    for (Mount& m : mounts) {
+        if (m.probe) {
+            if (m.probe->done) {
+                const struct statvfs& st = m.probe->result;
+                FilesystemInfo& info = m.info;
+                if (m.probe->ok) {
+                    // Same arithmetic as df: used = total - free, avail excludes reserved blocks
+                    info.state = FS_OK;
+                    info.total = (long long)st.f_blocks * st.f_frsize;
+                    info.used = (long long)(st.f_blocks - st.f_bfree) * st.f_frsize;
+                    info.available = (long long)st.f_bavail * st.f_frsize;
+                    long long usable = info.used + info.available;
+                    info.percentage = usable > 0 ? (double)info.used / usable * 100.0 : 0.0;
+                    info.inodes_total = st.f_files;
+                    info.inodes_used = st.f_files - st.f_ffree;
+                    info.inodes_percentage = st.f_files > 0 ? (double)info.inodes_used / st.f_files * 100.0 : 0.0;
+                } else {
+                    info.state = FS_ERROR;
+                }
+                m.probe.reset();
+                m.last_probe_ms = now_ms;
+                changed = true;
+                continue;
+            }
+
+            uint64_t started = m.probe->started_ms;
+            if (started > 0 && now_ms > started + TIMEOUT_MS && m.info.state != FS_HUNG) {
+                m.info.state = FS_HUNG;
+                changed = true;
+                // Leave the stuck worker to its call and hand its queue to a fresh one
+                vector<shared_ptr<StatvfsProbe>> rest;
+                {
+                    lock_guard<mutex> guard(worker->lock);
+                    if (worker->current == m.probe) {
+                        worker->abandoned = true;
+                        rest.swap(worker->queue);
+                    }
+                }
+                if (worker->abandoned) {
+                    startWorker();
+                    due.insert(due.end(), rest.begin(), rest.end());
+                }
+            }
+            continue;
+        }
+
+        if (m.last_probe_ms == 0 || now_ms >= m.last_probe_ms + REFRESH_MS) {
+            m.probe = make_shared<StatvfsProbe>(m.info.mount_point);
+            due.push_back(m.probe);
+        }
+    }
+
+    if (!due.empty()) {
+        {
+            lock_guard<mutex> guard(worker->lock);
+            worker->queue.insert(worker->queue.end(), due.begin(), due.end());
+        }
+        worker->cv.notify_one();
+    }
+    return changed;
+}
+
+void FilesystemMonitor::publish(vector<FilesystemInfo>& out) const
+{
+    out.clear();
+    for (const Mount& m : mounts) {
+        // Whatever is left with no blocks at all (an empty overlay of a pseudo fs) isn't storage
+        if (m.info.state == FS_OK && m.info.total == 0) continue;
+        out.push_back(m.info);
+    }
+}
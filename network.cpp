@@ -1,86 +1,95 @@
 #include "header.h"
-#include <sstream>
+#include <string.h>
+#include <net/if.h>
 
-// Get network interfaces with statistics
-vector<NetworkInterface> getNetworkInterfaces()
+// getifaddrs() allocates on every call, so addresses are refreshed on this interval
+static const double IP_REFRESH_INTERVAL = 10.0;
+
+struct InterfaceIP {
+    char name[IFNAMSIZ];
+    char ip[INET_ADDRSTRLEN];
+};
+
+// IPv4 address of every interface that has one, refreshed every IP_REFRESH_INTERVAL
+static const vector<InterfaceIP>& getInterfaceIPs()
 {
-    vector<NetworkInterface> interfaces;
+    static vector<InterfaceIP> interface_ips;
+    static double last_refresh = -1.0;
 
-    // Get IP addresses first
-    map<string, string> interface_ips;
-    struct ifaddrs *ifaddr, *ifa;
+    double now = SDL_GetTicks() / 1000.0;
+    if (last_refresh >= 0.0 && now - last_refresh < IP_REFRESH_INTERVAL) {
+        return interface_ips;
+    }
+    last_refresh = now;
+    interface_ips.clear();
 
+    struct ifaddrs *ifaddr, *ifa;
     if (getifaddrs(&ifaddr) != -1) {
         for (ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
             if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET) {
                 struct sockaddr_in* addr_in = (struct sockaddr_in*)ifa->ifa_addr;
-                char ip_str[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &(addr_in->sin_addr), ip_str, INET_ADDRSTRLEN);
-                interface_ips[ifa->ifa_name] = string(ip_str);
+                InterfaceIP entry;
+                snprintf(entry.name, sizeof(entry.name), "%s", ifa->ifa_name);
+                inet_ntop(AF_INET, &(addr_in->sin_addr), entry.ip, INET_ADDRSTRLEN);
+                interface_ips.push_back(entry);
             }
         }
         freeifaddrs(ifaddr);
     }
+    return interface_ips;
+}
 
-    // Read network statistics from /proc/net/dev
-    ifstream dev_file("/proc/net/dev");
-    string line;
+// Get network interfaces with statistics
+pmr::vector<NetworkInterface> getNetworkInterfaces(pmr::memory_resource* mr)
+{
+    ALLOC_SCOPE("getNetworkInterfaces");
+    PROFILE_SCOPE("getNetworkInterfaces");
+    pmr::vector<NetworkInterface> interfaces(mr);
 
-    // Skip header lines
-    getline(dev_file, line);
-    getline(dev_file, line);
+    // Get IP addresses first
+    const vector<InterfaceIP>& interface_ips = getInterfaceIPs();
 
-    while (getline(dev_file, line)) {
-        istringstream iss(line);
-        string interface_name;
+    // Read network statistics from /proc/net/dev; hosts with many veth
+    // interfaces make this file large, so the buffer isn't on the stack
+    static char buf[128 * 1024];
+    if (readProcFile("/proc/net/dev", buf, sizeof(buf)) <= 0) {
+        return interfaces;
+    }
 
-        // Extract interface name (remove colon)
-        iss >> interface_name;
-        if (!interface_name.empty() && interface_name.back() == ':') {
-            interface_name.pop_back();
-        }
+    // Skip header lines
+    char* line = strchr(buf, '\n');
+    if (line) line = strchr(line + 1, '\n');
 
-        NetworkInterface iface;
-        iface.name = interface_name;
-        iface.ip = interface_ips.count(interface_name) ? interface_ips[interface_name] : "N/A";
+    while (line && *++line) {
+        char* next = strchr(line, '\n');
+        if (next) *next = '\0';
 
-        // Read RX statistics
-        iss >> iface.rx_bytes >> iface.rx_packets >> iface.rx_errors >> iface.rx_dropped;
+        // Extract interface name (up to the colon)
+        char* colon = strchr(line, ':');
+        if (!colon) break;
+        *colon = '\0';
+        while (*line == ' ') line++;
 
-        // Skip some fields
-        long long temp;
-        iss >> temp >> temp >> temp >> temp; // fifo, frame, compressed, multicast
+        NetworkInterface iface;
+        iface.name = line;
+        iface.ip = "N/A";
+        for (const InterfaceIP& entry : interface_ips) {
+            if (strcmp(entry.name, line) == 0) {
+                iface.ip = entry.ip;
+                break;
+            }
+        }
 
-        // Read TX statistics
-        iss >> iface.tx_bytes >> iface.tx_packets >> iface.tx_errors >> iface.tx_dropped;
+        // RX statistics, then fifo, frame, compressed, multicast, then TX statistics
+        long long skip;
+        sscanf(colon + 1, "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+               &iface.rx_bytes, &iface.rx_packets, &iface.rx_errors, &iface.rx_dropped,
+               &skip, &skip, &skip, &skip,
+               &iface.tx_bytes, &iface.tx_packets, &iface.tx_errors, &iface.tx_dropped);
 
         interfaces.push_back(iface);
+        line = next;
     }
 
     return interfaces;
 }
-
-// Format bytes to appropriate unit (B, KB, MB, GB)
-string formatBytes(long long bytes)
-{
-    const char* units[] = {"B", "KB", "MB", "GB", "TB"};
-    int unit_index = 0;
-    double size = (double)bytes;
-
-    while (size >= 1024.0 && unit_index < 4) {
-        size /= 1024.0;
-        unit_index++;
-    }
-
-    // Format with appropriate precision
-    ostringstream oss;
-    if (unit_index == 0) {
-        oss << (long long)size << " " << units[unit_index];
-    } else {
-        oss << fixed;
-        oss.precision(2);
-        oss << size << " " << units[unit_index];
-    }
-
-    return oss.str();
-}
@@ -0,0 +1,112 @@
+#include "header.h"
+
+// Fixed worker pool for splitting a scan across cores.
+// parallelFor() hands out indices from one atomic counter, so a worker that
+// finishes early simply claims the next chunk instead of idling while another
+// works through a slow one. The calling thread claims chunks as well.
+
+WorkerPool::WorkerPool() : job(nullptr), job_count(0), next(0), active(0), generation(0), stopping(false),
+                           worker_cpu(0.0)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    resize(0);
+}
+
+void WorkerPool::resize(int threads)
+{
+    if (threads == (int)workers.size()) return;
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (thread& worker : workers) worker.join();
+    workers.clear();
+
+    stopping = false;
+    for (int i = 0; i < threads; i++) {
+        // Started at the current generation, so a job posted before the thread
+        // first takes the lock is still picked up
+        workers.emplace_back(&WorkerPool::workerLoop, this, i, generation);
+    }
+}
+
+// Claims and runs indices of the current job until there are none left
+void WorkerPool::drain()
+{
+    for (int i = next.fetch_add(1); i < job_count; i = next.fetch_add(1)) {
+        (*job)(i);
+    }
+}
+
+double WorkerPool::parallelFor(int count, const function<void(int)>& body)
+{
+    if (workers.empty() || count <= 1) {
+        for (int i = 0; i < count; i++) body(i);
+        return 0.0;
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        job = &body;
+        job_count = count;
+        next = 0;
+        active = (int)workers.size();
+        worker_cpu = 0.0;
+        generation++;
+    }
+    start_cv.notify_all();
+
+    drain();
+
+    // `body` lives on our stack, so every worker must be done with it before returning
+    unique_lock<mutex> guard(lock);
+    done_cv.wait(guard, [this] { return active == 0; });
+    job = nullptr;
+    return worker_cpu;
+}
+
+void WorkerPool::workerLoop(int index, uint64_t seen)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "scan%d", index);
+    pthread_setname_np(pthread_self(), name);
+
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        start_cv.wait(guard, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+
+        // The governor times only the thread that runs a collector; the workers report their share
+        guard.unlock();
+        double cpu_start = threadCpuSeconds();
+        drain();
+        double cpu = threadCpuSeconds() - cpu_start;
+        guard.lock();
+        worker_cpu += cpu;
+
+        if (--active == 0) done_cv.notify_one();
+    }
+}
+
+// ---- Process scan threads ----
+
+static atomic<int> requestedScanThreads(-1);
+
+// Small hosts rarely have enough processes for a split to pay for the wakeups
+int scanThreads()
+{
+    int requested = requestedScanThreads;
+    if (requested >= 0) return requested;
+    int cores = (int)thread::hardware_concurrency();
+    return cores >= 4 ? min(cores / 2, 8) - 1 : 0;
+}
+
+void setScanThreads(int threads)
+{
+    requestedScanThreads = threads;
+}
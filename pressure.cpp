@@ -0,0 +1,98 @@
+#include "header.h"
+#include <fcntl.h>
+
+// CPU, memory and I/O pressure from /proc/pressure/{cpu,memory,io}.
+// The kernel's avg10/60/300 are exponential averages that lag behind a spike;
+// the graphs come from the `total` stall microseconds instead, divided by the
+// wall time between two reads, so each point is the share of exactly that
+// interval spent stalled.
+
+static const char* const pressurePaths[PRESSURE_COUNT] = {
+    "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io",
+};
+
+// "some avg10=1.10 avg60=1.62 avg300=1.71 total=78513152"
+static bool parsePressureLine(const char* p, PressureLine& line)
+{
+    const char* avg10 = strstr(p, "avg10=");
+    const char* avg60 = strstr(p, "avg60=");
+    const char* avg300 = strstr(p, "avg300=");
+    const char* total = strstr(p, "total=");
+    const char* end = strchr(p, '\n');
+    if (!avg10 || !avg60 || !avg300 || !total || (end && total > end)) return false;
+    line.avg10 = strtod(avg10 + 6, nullptr);
+    line.avg60 = strtod(avg60 + 6, nullptr);
+    line.avg300 = strtod(avg300 + 7, nullptr);
+    line.total = strtoull(total + 6, nullptr, 10);
+    return true;
+}
+
+static double stallRate(unsigned long long total, unsigned long long prev, double elapsed_us)
+{
+    if (total < prev || elapsed_us <= 0.0) return 0.0;
+    return min(100.0, (total - prev) / elapsed_us * 100.0);
+}
+
+PressureReader::~PressureReader()
+{
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool PressureReader::update(PressureStats& stats)
+{
+    PROFILE_SCOPE("pressure");
+    if (!opened) {
+        opened = true;
+        for (int i = 0; i < PRESSURE_COUNT; i++) {
+            fds[i] = open(pressurePaths[i], O_RDONLY | O_CLOEXEC);
+        }
+    }
+
+    // The three files are read back to back against one timestamp
+    uint64_t now = profileNow();
+    double elapsed_us = last_ns > 0 ? (now - last_ns) / 1000.0 : 0.0;
+    last_ns = now;
+
+    bool any = false;
+    for (int i = 0; i < PRESSURE_COUNT; i++) {
+        PressureResourceStats& res = stats.resources[i];
+        char buf[256];
+        ssize_t len = fds[i] >= 0 ? pread(fds[i], buf, sizeof(buf) - 1, 0) : -1;
+        if (len <= 0) {
+            res.available = false;
+            continue;
+        }
+        buf[len] = '\0';
+
+        PressureLine some = res.some;
+        PressureLine full = res.full;
+        const char* some_line = strstr(buf, "some ");
+        const char* full_line = strstr(buf, "full ");
+        if (some_line == nullptr || !parsePressureLine(some_line, some)) {
+            res.available = false;
+            continue;
+        }
+        // Kernels before 5.13 have no "full" line for cpu
+        if (full_line == nullptr || !parsePressureLine(full_line, full)) {
+            full.avg10 = full.avg60 = full.avg300 = 0.0;
+            full.total = 0;
+        }
+        res.available = true;
+        any = true;
+
+        if (res.has_prev && elapsed_us > 0.0) {
+            some.rate = stallRate(some.total, res.some.total, elapsed_us);
+            full.rate = stallRate(full.total, res.full.total, elapsed_us);
+            res.some_history[res.history_pos] = (float)some.rate;
+            res.full_history[res.history_pos] = (float)full.rate;
+            res.history_pos = (res.history_pos + 1) % PRESSURE_HISTORY;
+            if (res.history_len < PRESSURE_HISTORY) res.history_len++;
+        }
+        res.some = some;
+        res.full = full;
+        res.has_prev = true;
+    }
+    return any;
+}
@@ -0,0 +1,441 @@
+#include "header.h"
+#include <algorithm>
+#include <string.h>
+#include <sstream>
+#include <pwd.h>
+
+// Smallest prefix selected when only the top of the table is visible, so that
+// small scrolls don't force another selection pass
+static const size_t TOP_K_MIN = 128;
+
+// Compare two processes by the table sort keys; pid breaks ties so the order is stable
+int compareProcs(const Proc& a, const Proc& b, const vector<SortKey>& keys)
+{
+    for (const SortKey& key : keys) {
+        int c = 0;
+        switch (key.column) {
+            case PROC_COL_PID:   c = (a.pid > b.pid) - (a.pid < b.pid); break;
+            case PROC_COL_NAME:  c = a.name.compare(b.name); c = (c > 0) - (c < 0); break;
+            case PROC_COL_STATE: c = (a.state > b.state) - (a.state < b.state); break;
+            case PROC_COL_CPU:   c = (a.cpu_usage > b.cpu_usage) - (a.cpu_usage < b.cpu_usage); break;
+            case PROC_COL_MEM:   c = (a.mem_usage > b.mem_usage) - (a.mem_usage < b.mem_usage); break;
+            case PROC_COL_READ:  c = (a.read_rate > b.read_rate) - (a.read_rate < b.read_rate); break;
+            case PROC_COL_WRITE: c = (a.write_rate > b.write_rate) - (a.write_rate < b.write_rate); break;
+            case PROC_COL_SYSCALLS:
+                c = (a.syscall_rate > b.syscall_rate) - (a.syscall_rate < b.syscall_rate);
+                break;
+            case PROC_COL_IO: {
+                double io_a = a.read_rate + a.write_rate, io_b = b.read_rate + b.write_rate;
+                c = (io_a > io_b) - (io_a < io_b);
+                break;
+            }
+        }
+        if (c != 0) {
+            return key.descending ? -c : c;
+        }
+    }
+    return (a.pid > b.pid) - (a.pid < b.pid);
+}
+
+// FNV-1a; comm only changes on exec, so a hash is enough to notice it
+static uint64_t hashName(const string& name)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : name) {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static bool sameSortValues(const ProcessOrder::OrderedRow& row, const Proc& proc)
+{
+    return row.state == proc.state && row.cpu_usage == proc.cpu_usage &&
+           row.mem_usage == proc.mem_usage && row.read_rate == proc.read_rate &&
+           row.write_rate == proc.write_rate && row.syscall_rate == proc.syscall_rate &&
+           row.name_hash == hashName(proc.name);
+}
+
+// Record rank and sort-relevant values of every row, so the next update() can
+// tell which rows kept their place
+static void syncRows(ProcessOrder& po, const vector<Proc>& snapshot)
+{
+    pmr::vector<int> rank(snapshot.size(), frameArena());
+    for (size_t i = 0; i < po.order.size(); i++) {
+        rank[po.order[i]] = (int)i;
+    }
+
+    po.ordered.resize(po.by_pid.size());
+    for (size_t i = 0; i < po.by_pid.size(); i++) {
+        const Proc& proc = snapshot[po.by_pid[i]];
+        po.ordered[i] = {proc.pid, rank[po.by_pid[i]], proc.state, proc.cpu_usage, proc.mem_usage,
+                         proc.read_rate, proc.write_rate, proc.syscall_rate, hashName(proc.name)};
+    }
+}
+
+// New sort keys invalidate the order; the next ensureSorted() sorts from scratch
+void ProcessOrder::setKeys(const vector<SortKey>& new_keys)
+{
+    keys = new_keys;
+    sorted_count = keys.empty() ? order.size() : 0;
+}
+
+// Carry the current order over to a new snapshot (or a new filtered row set).
+// Rows whose sort values didn't change are still in order relative to each other,
+// so when the previous order was complete only the changed and new rows are sorted
+// and merged back in: O(n + k log k) for k changed rows instead of a full sort.
+void ProcessOrder::update(const vector<Proc>& snapshot, const vector<int>& rows)
+{
+    ALLOC_SCOPE("ProcessOrder::update");
+    PROFILE_SCOPE("ProcessOrder::update");
+    bool was_sorted = !keys.empty() && sorted_count == order.size();
+
+    // /proc lists pids in ascending order, so this is normally sorted already
+    by_pid = rows;
+    auto pidLess = [&](int a, int b) { return snapshot[a].pid < snapshot[b].pid; };
+    if (!is_sorted(by_pid.begin(), by_pid.end(), pidLess)) {
+        sort(by_pid.begin(), by_pid.end(), pidLess);
+    }
+
+    // Merge-join previous rows with the new ones by pid. Unchanged rows go back
+    // to their previous rank; changed, new and reappearing rows are set aside.
+    pmr::vector<int> slots(ordered.size(), -1, frameArena());
+    pmr::vector<int> moved(frameArena());
+    size_t i = 0;
+    for (int r : by_pid) {
+        int pid = snapshot[r].pid;
+        while (i < ordered.size() && ordered[i].pid < pid) i++;
+
+        if (i < ordered.size() && ordered[i].pid == pid && sameSortValues(ordered[i], snapshot[r])) {
+            slots[ordered[i].rank] = r;
+        } else {
+            moved.push_back(r);
+        }
+    }
+
+    order.clear();
+    order.reserve(by_pid.size());
+    for (int r : slots) {
+        if (r >= 0) order.push_back(r);
+    }
+
+    if (keys.empty()) {
+        order.insert(order.end(), moved.begin(), moved.end());
+        sorted_count = order.size();
+    } else if (was_sorted && moved.size() <= by_pid.size() / 4) {
+        auto less = [&](int a, int b) { return compareProcs(snapshot[a], snapshot[b], keys) < 0; };
+        sort(moved.begin(), moved.end(), less);
+        pmr::vector<int> merged(order.size() + moved.size(), frameArena());
+        merge(order.begin(), order.end(), moved.begin(), moved.end(), merged.begin(), less);
+        order.assign(merged.begin(), merged.end());
+        sorted_count = order.size();
+    } else {
+        // Too much changed for a repair to pay off; sort on demand instead
+        order.insert(order.end(), moved.begin(), moved.end());
+        sorted_count = 0;
+    }
+    syncRows(*this, snapshot);
+}
+
+// Make sure at least the first `count` rows are in final order.
+// When only the top of the table is requested, the top rows are selected with a
+// partial sort; the remainder is sorted the first time a row past them is needed.
+void ProcessOrder::ensureSorted(const vector<Proc>& snapshot, size_t count)
+{
+    PROFILE_SCOPE("ProcessOrder::ensureSorted");
+    size_t n = order.size();
+    if (count > n) count = n;
+    if (sorted_count >= count) return;
+
+    auto less = [&](int a, int b) { return compareProcs(snapshot[a], snapshot[b], keys) < 0; };
+
+    if (sorted_count == 0 && count < n / 2) {
+        size_t k = min(n, max(count, TOP_K_MIN));
+        partial_sort(order.begin(), order.begin() + k, order.end(), less);
+        sorted_count = k;
+    } else {
+        // Everything past sorted_count already compares after the sorted prefix
+        sort(order.begin() + sorted_count, order.end(), less);
+        sorted_count = n;
+    }
+    syncRows(*this, snapshot);
+}
+
+// Compare the bytes after a first-byte hit; `needle` is lowercase when icase is set
+static bool restMatches(const char* p, const string& needle, bool icase)
+{
+    if (!icase) {
+        return memcmp(p + 1, needle.data() + 1, needle.size() - 1) == 0;
+    }
+    for (size_t i = 1; i < needle.size(); i++) {
+        if (tolower((unsigned char)p[i]) != needle[i]) return false;
+    }
+    return true;
+}
+
+// Substring search that jumps between candidate positions with memchr on the
+// first needle byte (both cases of it when ignoring case)
+bool containsText(const char* hay, size_t hay_len, const string& needle, bool icase)
+{
+    size_t n = needle.size();
+    if (n == 0) return true;
+    if (n > hay_len) return false;
+
+    const char* end = hay + hay_len - n + 1; // one past the last possible start
+    char first = needle[0];
+    char other = icase ? (char)toupper((unsigned char)first) : first;
+
+    const char* p = hay;
+    while (p < end) {
+        const char* a = (const char*)memchr(p, first, end - p);
+        const char* b = (other != first) ? (const char*)memchr(p, other, (a ? a : end) - p) : nullptr;
+        const char* hit = b ? b : a;
+        if (!hit) return false;
+        if (restMatches(hit, needle, icase)) return true;
+        p = hit + 1;
+    }
+    return false;
+}
+
+static bool equalsText(const string& value, const string& text, bool icase)
+{
+    if (value.size() != text.size()) return false;
+    if (!icase) return value == text;
+    for (size_t i = 0; i < value.size(); i++) {
+        if (tolower((unsigned char)value[i]) != text[i]) return false;
+    }
+    return true;
+}
+
+static bool compareNumber(int op, double value, double operand)
+{
+    switch (op) {
+        case FILTER_EQ: return value == operand;
+        case FILTER_NE: return value != operand;
+        case FILTER_LT: return value < operand;
+        case FILTER_LE: return value <= operand;
+        case FILTER_GT: return value > operand;
+        case FILTER_GE: return value >= operand;
+    }
+    return false;
+}
+
+// Keep only the rows that satisfy `pred`, preserving their order
+template <typename Pred>
+static void keepRows(vector<int>& rows, Pred pred)
+{
+    size_t out = 0;
+    for (int r : rows) {
+        if (pred(r)) rows[out++] = r;
+    }
+    rows.resize(out);
+}
+
+static int parseField(const string& name)
+{
+    if (name == "pid") return PROC_COL_PID;
+    if (name == "name") return PROC_COL_NAME;
+    if (name == "state") return PROC_COL_STATE;
+    if (name == "cpu") return PROC_COL_CPU;
+    if (name == "mem" || name == "memory") return PROC_COL_MEM;
+    if (name == "read") return PROC_COL_READ;
+    if (name == "write") return PROC_COL_WRITE;
+    if (name == "io") return PROC_COL_IO;
+    if (name == "user") return PROC_FIELD_USER;
+    if (name == "cmd") return PROC_FIELD_CMD;
+    return -1;
+}
+
+// Split "field<op>value" at the operator; returns false if there is no operator
+static bool splitTerm(const string& token, string& field, int& op, string& value)
+{
+    size_t pos = token.find_first_of("~=<>!");
+    if (pos == string::npos) return false;
+
+    static const struct { const char* text; int op; } ops[] = {
+        {"!~", FILTER_NOT_CONTAINS}, {"!=", FILTER_NE}, {"<=", FILTER_LE}, {">=", FILTER_GE},
+        {"~", FILTER_CONTAINS}, {"=", FILTER_EQ}, {"<", FILTER_LT}, {">", FILTER_GT},
+    };
+    for (const auto& o : ops) {
+        size_t len = strlen(o.text);
+        if (token.compare(pos, len, o.text) == 0) {
+            field = token.substr(0, pos);
+            op = o.op;
+            value = token.substr(pos + len);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Compile a filter expression into terms. Terms that don't parse are skipped
+// and the first problem is reported in `error`.
+void ProcessFilter::compile(const string& text, bool icase)
+{
+    terms.clear();
+    error.clear();
+    ignore_case = icase;
+
+    istringstream iss(text);
+    string token;
+    while (iss >> token) {
+        FilterTerm term = {PROC_COL_NAME, FILTER_CONTAINS, 0.0, token};
+        string field, value;
+
+        if (splitTerm(token, field, term.op, value)) {
+            term.field = parseField(field);
+            term.text = value;
+            if (term.field < 0) {
+                if (error.empty()) error = "unknown field '" + field + "'";
+                continue;
+            }
+            if (value.empty()) {
+                if (error.empty()) error = "missing value after '" + field + "'";
+                continue;
+            }
+        }
+
+        bool ordering = term.op == FILTER_LT || term.op == FILTER_LE || term.op == FILTER_GT || term.op == FILTER_GE;
+        bool substring = term.op == FILTER_CONTAINS || term.op == FILTER_NOT_CONTAINS;
+
+        if (term.field == PROC_FIELD_CMD) {
+            if (!substring) {
+                if (error.empty()) error = "'" + token + "': cmd only supports ~ and !~";
+                continue;
+            }
+            if (icase) {
+                for (char& c : term.text) c = (char)tolower((unsigned char)c);
+            }
+        } else if (term.field == PROC_COL_NAME || term.field == PROC_COL_STATE) {
+            if (ordering) {
+                if (error.empty()) error = "'" + token + "': only ~ != = work on text";
+                continue;
+            }
+            if (icase && term.field == PROC_COL_NAME) {
+                for (char& c : term.text) c = (char)tolower((unsigned char)c);
+            }
+        } else if (term.field == PROC_FIELD_USER) {
+            if (ordering || substring) {
+                if (error.empty()) error = "'" + token + "': user only supports = and !=";
+                continue;
+            }
+            // Resolve the name once here so rows compare plain uids
+            struct passwd* pw = getpwnam(term.text.c_str());
+            char* end = nullptr;
+            if (pw) {
+                term.number = pw->pw_uid;
+            } else {
+                term.number = strtod(term.text.c_str(), &end);
+                if (*end != '\0') {
+                    if (error.empty()) error = "unknown user '" + term.text + "'";
+                    term.number = -1; // no process runs as this
+                }
+            }
+        } else {
+            if (substring) {
+                if (error.empty()) error = "'" + token + "': ~ only works on name and state";
+                continue;
+            }
+            char* end = nullptr;
+            term.number = strtod(term.text.c_str(), &end);
+            // Byte rates take a K/M/G suffix: io>10M
+            bool rate = term.field == PROC_COL_READ || term.field == PROC_COL_WRITE || term.field == PROC_COL_IO;
+            static const char units[] = "KMG";
+            const char* suffix = rate && *end ? strchr(units, toupper((unsigned char)*end)) : nullptr;
+            if (suffix && end[1] == '\0') {
+                term.number *= (double)(1LL << (10 * (suffix - units + 1)));
+                end++;
+            }
+            if (*end != '\0') {
+                if (error.empty()) error = "'" + token + "': expected a number";
+                continue;
+            }
+        }
+        terms.push_back(term);
+    }
+
+    // Numeric tests are cheapest and usually most selective, so they run first
+    stable_sort(terms.begin(), terms.end(), [](const FilterTerm& a, const FilterTerm& b) {
+        bool a_text = a.field == PROC_COL_NAME || a.field == PROC_FIELD_CMD;
+        bool b_text = b.field == PROC_COL_NAME || b.field == PROC_FIELD_CMD;
+        return a_text < b_text;
+    });
+}
+
+bool ProcessFilter::usesCmdline() const
+{
+    for (const FilterTerm& term : terms) {
+        if (term.field == PROC_FIELD_CMD) return true;
+    }
+    return false;
+}
+
+// Fill `rows` with the indices of snapshot rows that match every term.
+// Terms run one at a time over the surviving rows, so each inner loop is a
+// single tight test rather than the whole expression per row.
+void ProcessFilter::apply(const vector<Proc>& snapshot, vector<int>& rows, const CmdlineIndex& cmdlines) const
+{
+    ALLOC_SCOPE("ProcessFilter::apply");
+    PROFILE_SCOPE("ProcessFilter::apply");
+    rows.resize(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        rows[i] = (int)i;
+    }
+
+    for (const FilterTerm& term : terms) {
+        const string& text = term.text;
+        bool negate = term.op == FILTER_NOT_CONTAINS || term.op == FILTER_NE;
+
+        switch (term.field) {
+            case PROC_COL_NAME:
+                if (term.op == FILTER_CONTAINS || term.op == FILTER_NOT_CONTAINS) {
+                    bool icase = ignore_case;
+                    keepRows(rows, [&](int r) {
+                        const string& name = snapshot[r].name;
+                        return containsText(name.data(), name.size(), text, icase) != negate;
+                    });
+                } else {
+                    keepRows(rows, [&](int r) { return equalsText(snapshot[r].name, text, ignore_case) != negate; });
+                }
+                break;
+            case PROC_COL_STATE:
+                // state=R matches one state, state~RD matches any of the listed ones
+                if (term.op == FILTER_CONTAINS || term.op == FILTER_NOT_CONTAINS) {
+                    keepRows(rows, [&](int r) { return (text.find(snapshot[r].state) != string::npos) != negate; });
+                } else {
+                    keepRows(rows, [&](int r) { return (text.size() == 1 && snapshot[r].state == text[0]) != negate; });
+                }
+                break;
+            case PROC_COL_PID:
+                keepRows(rows, [&](int r) { return compareNumber(term.op, snapshot[r].pid, term.number); });
+                break;
+            case PROC_COL_CPU:
+                keepRows(rows, [&](int r) { return compareNumber(term.op, snapshot[r].cpu_usage, term.number); });
+                break;
+            case PROC_COL_MEM:
+                keepRows(rows, [&](int r) { return compareNumber(term.op, snapshot[r].mem_usage, term.number); });
+                break;
+            case PROC_COL_READ:
+                keepRows(rows, [&](int r) { return compareNumber(term.op, snapshot[r].read_rate, term.number); });
+                break;
+            case PROC_COL_WRITE:
+                keepRows(rows, [&](int r) { return compareNumber(term.op, snapshot[r].write_rate, term.number); });
+                break;
+            case PROC_COL_IO:
+                keepRows(rows, [&](int r) {
+                    return compareNumber(term.op, snapshot[r].read_rate + snapshot[r].write_rate, term.number);
+                });
+                break;
+            case PROC_FIELD_USER:
+                keepRows(rows, [&](int r) { return compareNumber(term.op, snapshot[r].uid, term.number); });
+                break;
+            case PROC_FIELD_CMD: {
+                // The index answers for all processes at once; rows just look themselves up
+                pmr::vector<int> pids(frameArena());
+                cmdlines.search(text, ignore_case, pids);
+                keepRows(rows, [&](int r) { return binary_search(pids.begin(), pids.end(), snapshot[r].pid) != negate; });
+                break;
+            }
+        }
+        if (rows.empty()) break;
+    }
+}
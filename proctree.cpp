@@ -0,0 +1,183 @@
+#include "header.h"
+#include <algorithm>
+
+// Process tree built from the ppid of each process.
+// Subtree totals are kept up to date rather than recomputed: a process that
+// exits takes its own values out of its ancestors, a new one adds them, and a
+// process whose CPU%, RSS or thread count moved adds only the difference. On a
+// host where most processes are idle a scan touches few ancestor chains.
+// Rows are rebuilt separately, when the snapshot, filter, sort or a collapsed
+// node changes.
+
+// Adds to the totals of `pid` and every ancestor above it
+void ProcessTree::addUp(int pid, double cpu, long long rss, int threads, int procs)
+{
+    while (pid != 0) {
+        Node& node = nodes[pid];
+        node.subtree_cpu += cpu;
+        node.subtree_rss += rss;
+        node.subtree_threads += threads;
+        node.subtree_procs += procs;
+        pid = node.parent;
+    }
+}
+
+void ProcessTree::detach(int pid, Node& node)
+{
+    if (node.parent == 0) return;
+    addUp(node.parent, -node.subtree_cpu, -node.subtree_rss, -node.subtree_threads, -node.subtree_procs);
+    vector<int>& siblings = nodes[node.parent].children;
+    siblings.erase(std::find(siblings.begin(), siblings.end(), pid));
+    node.parent = 0;
+}
+
+void ProcessTree::attach(int pid, Node& node, int parent)
+{
+    // A snapshot isn't atomic: a reused pid can make a process its own ancestor
+    for (int p = parent; p != 0; p = nodes[p].parent) {
+        if (p == pid) return;
+    }
+    node.parent = parent;
+    nodes[parent].children.push_back(pid);
+    addUp(parent, node.subtree_cpu, node.subtree_rss, node.subtree_threads, node.subtree_procs);
+}
+
+// Orphans stay as roots until the snapshot shows where they were reparented
+void ProcessTree::remove(int pid)
+{
+    Node& node = nodes[pid];
+    while (!node.children.empty()) {
+        int child = node.children.back();
+        detach(child, nodes[child]);
+    }
+    detach(pid, node);
+    nodes.erase(pid);
+}
+
+void ProcessTree::update(const vector<Proc>& snapshot)
+{
+    PROFILE_SCOPE("process tree");
+    for (auto& entry : nodes) {
+        entry.second.seen = false;
+    }
+    for (const Proc& proc : snapshot) {
+        auto it = nodes.find(proc.pid);
+        if (it != nodes.end() && it->second.starttime == proc.starttime) it->second.seen = true;
+    }
+
+    // Exited processes, and pids reused by a different process, go first
+    vector<int> gone;
+    for (const auto& entry : nodes) {
+        if (!entry.second.seen) gone.push_back(entry.first);
+    }
+    for (int pid : gone) {
+        remove(pid);
+    }
+
+    // New processes start as roots; changed values move up the existing links
+    for (int i = 0; i < (int)snapshot.size(); i++) {
+        const Proc& proc = snapshot[i];
+        auto it = nodes.find(proc.pid);
+        if (it == nodes.end()) {
+            Node node;
+            node.starttime = proc.starttime;
+            node.parent = 0;
+            node.index = i;
+            node.cpu = node.subtree_cpu = 0.0;
+            node.rss = node.subtree_rss = 0;
+            node.threads = node.subtree_threads = 0;
+            node.subtree_procs = 1;
+            node.collapsed = false;
+            node.seen = true;
+            it = nodes.emplace(proc.pid, move(node)).first;
+        }
+        Node& node = it->second;
+        node.index = i;
+        double cpu = proc.cpu_usage - node.cpu;
+        long long rss = proc.rss - node.rss;
+        int threads = proc.num_threads - node.threads;
+        if (cpu != 0.0 || rss != 0 || threads != 0) {
+            addUp(proc.pid, cpu, rss, threads, 0);
+            node.cpu = proc.cpu_usage;
+            node.rss = proc.rss;
+            node.threads = proc.num_threads;
+        }
+    }
+
+    // Links are fixed once every parent is known; a parent we can't see makes a root
+    for (const Proc& proc : snapshot) {
+        Node& node = nodes[proc.pid];
+        int parent = proc.ppid != proc.pid && nodes.count(proc.ppid) ? proc.ppid : 0;
+        if (parent == node.parent) continue;
+        detach(proc.pid, node);
+        if (parent != 0) attach(proc.pid, node, parent);
+    }
+}
+
+// Snapshot index of `pid`, or -1 if it isn't in `snapshot`
+static int snapshotIndex(const ProcessTree& tree, const vector<Proc>& snapshot, int pid)
+{
+    const ProcessTree::Node* node = tree.find(pid);
+    if (node == nullptr || node->index >= (int)snapshot.size() || snapshot[node->index].pid != pid) return -1;
+    return node->index;
+}
+
+// Rows for the processes in `visible` plus their ancestors, so a filtered
+// process still shows where it runs. Children of collapsed nodes are left out.
+// `snapshot` must be the one of the last update(); pids it doesn't map are skipped.
+void ProcessTree::buildRows(const vector<Proc>& snapshot, const vector<int>& visible, const vector<SortKey>& keys)
+{
+    PROFILE_SCOPE("process tree rows");
+    rows.clear();
+    pmr::vector<char> shown(snapshot.size(), 0, frameArena());
+    for (int index : visible) {
+        for (int pid = snapshot[index].pid; pid != 0; pid = find(pid)->parent) {
+            int i = snapshotIndex(*this, snapshot, pid);
+            if (i < 0 || shown[i]) break;
+            shown[i] = 1;
+        }
+    }
+
+    auto less = [&](int a, int b) { return compareProcs(snapshot[a], snapshot[b], keys) < 0; };
+    pmr::vector<int> roots(frameArena());
+    for (int i = 0; i < (int)snapshot.size(); i++) {
+        if (shown[i] && find(snapshot[i].pid)->parent == 0) roots.push_back(i);
+    }
+    sort(roots.begin(), roots.end(), less);
+
+    // Depth first with an explicit stack; siblings are pushed in reverse sort order
+    pmr::vector<Row> stack(frameArena());
+    pmr::vector<int> children(frameArena());
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+        stack.push_back({*it, 0});
+    }
+    while (!stack.empty()) {
+        Row row = stack.back();
+        stack.pop_back();
+        rows.push_back(row);
+
+        const Node* node = find(snapshot[row.index].pid);
+        if (node->collapsed) continue;
+        children.clear();
+        for (int child : node->children) {
+            int i = snapshotIndex(*this, snapshot, child);
+            if (i >= 0 && shown[i]) children.push_back(i);
+        }
+        sort(children.begin(), children.end(), less);
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            stack.push_back({*it, row.depth + 1});
+        }
+    }
+}
+
+const ProcessTree::Node* ProcessTree::find(int pid) const
+{
+    auto it = nodes.find(pid);
+    return it != nodes.end() ? &it->second : nullptr;
+}
+
+void ProcessTree::toggleCollapsed(int pid)
+{
+    auto it = nodes.find(pid);
+    if (it != nodes.end()) it->second.collapsed = !it->second.collapsed;
+}
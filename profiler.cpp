@@ -0,0 +1,200 @@
+#include "header.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include <time.h>
+
+// Scope timer storage.
+// Every thread that runs a PROFILE_SCOPE gets its own event ring, written only by
+// that thread and published with a release store of `head`; profileFrameEnd()
+// on the UI thread drains all rings, so timing a scope never takes a lock.
+
+static const int MAX_PROFILE_SCOPES = 64;
+static const uint32_t RING_EVENTS = 4096;     // power of two
+static const int MAX_FRAME_EVENTS = 512;      // kept for the timeline view
+static const int HISTORY_FRAMES = 240;        // window for the rolling percentiles
+
+struct ThreadRing {
+    ProfileEvent events[RING_EVENTS];
+    atomic<uint32_t> head;  // events written so far (wraps)
+    uint32_t tail;          // events consumed by the UI thread
+    int thread;
+};
+
+struct ScopeHistory {
+    const char* name;
+    uint64_t frame_ns;      // accumulated since the last profileFrameEnd()
+    int frame_calls;
+    float samples[HISTORY_FRAMES]; // ms per frame in which the scope ran
+    int next;
+    int count;
+    float last_ms;
+    int last_calls;
+};
+
+static ThreadRing* rings[MAX_PROFILE_THREADS];
+static atomic<int> ringCount(0);
+static ScopeHistory scopes[MAX_PROFILE_SCOPES];
+static atomic<int> scopeCount(0);
+static thread_local ThreadRing* threadRing = nullptr;
+static thread_local int threadDepth = 0;
+
+static ProfileEvent frameEvents[MAX_FRAME_EVENTS];
+static int frameEventCount = 0;
+static uint64_t frameStart = 0;
+static uint64_t lastFrameStart = 0;
+static uint64_t lastFrameEnd = 0;
+
+uint64_t profileNow()
+{
+    // CLOCK_MONOTONIC goes through the vDSO, so this is a few tens of ns with no
+    // syscall, and unlike rdtsc it needs no calibration or invariant-TSC check
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int profileScopeSlot(const char* name)
+{
+    static mutex lock;
+    lock_guard<mutex> guard(lock);
+    int n = scopeCount.load();
+    for (int i = 0; i < n; i++) {
+        if (strcmp(scopes[i].name, name) == 0) return i;
+    }
+    if (n >= MAX_PROFILE_SCOPES) return -1;
+    scopes[n].name = name;
+    scopeCount.store(n + 1);
+    return n;
+}
+
+static ThreadRing* currentRing()
+{
+    if (threadRing == nullptr) {
+        static mutex lock;
+        lock_guard<mutex> guard(lock);
+        int n = ringCount.load();
+        if (n >= MAX_PROFILE_THREADS) return nullptr;
+        // Rings live for the whole process; a thread that exits just stops writing
+        ThreadRing* ring = new ThreadRing();
+        ring->head.store(0);
+        ring->tail = 0;
+        ring->thread = n;
+        rings[n] = ring;
+        ringCount.store(n + 1);
+        threadRing = ring;
+    }
+    return threadRing;
+}
+
+ProfileScope::ProfileScope(int slot) : slot(slot), start(profileNow())
+{
+    threadDepth++;
+}
+
+ProfileScope::~ProfileScope()
+{
+    threadDepth--;
+    if (slot < 0) return;
+    ThreadRing* ring = currentRing();
+    if (ring == nullptr) return;
+
+    uint32_t head = ring->head.load(memory_order_relaxed);
+    ProfileEvent& e = ring->events[head & (RING_EVENTS - 1)];
+    e.scope = slot;
+    e.thread = ring->thread;
+    e.depth = threadDepth;
+    e.start = start;
+    e.end = profileNow();
+    ring->head.store(head + 1, memory_order_release);
+}
+
+void profileFrameBegin()
+{
+    frameStart = profileNow();
+}
+
+void profileFrameEnd()
+{
+    uint64_t frameEnd = profileNow();
+    frameEventCount = 0;
+
+    int nrings = ringCount.load(memory_order_acquire);
+    for (int r = 0; r < nrings; r++) {
+        ThreadRing* ring = rings[r];
+        uint32_t head = ring->head.load(memory_order_acquire);
+        // If a worker lapped us, the oldest events were overwritten; skip them
+        if (head - ring->tail > RING_EVENTS) ring->tail = head - RING_EVENTS;
+
+        for (; ring->tail != head; ring->tail++) {
+            const ProfileEvent& e = ring->events[ring->tail & (RING_EVENTS - 1)];
+            ScopeHistory& s = scopes[e.scope];
+            s.frame_ns += e.end - e.start;
+            s.frame_calls++;
+            if (e.end >= frameStart && frameEventCount < MAX_FRAME_EVENTS) {
+                frameEvents[frameEventCount++] = e;
+            }
+        }
+    }
+
+    int n = scopeCount.load();
+    for (int i = 0; i < n; i++) {
+        ScopeHistory& s = scopes[i];
+        s.last_calls = s.frame_calls;
+        s.last_ms = s.frame_ns / 1e6f;
+        if (s.frame_calls > 0) {
+            s.samples[s.next] = s.last_ms;
+            s.next = (s.next + 1) % HISTORY_FRAMES;
+            if (s.count < HISTORY_FRAMES) s.count++;
+        }
+        s.frame_ns = 0;
+        s.frame_calls = 0;
+    }
+
+    lastFrameStart = frameStart;
+    lastFrameEnd = frameEnd;
+}
+
+// Value at fraction `q` of `v` (nearest rank); reorders `v`
+static float percentile(float* v, int n, double q)
+{
+    int k = (int)(q * (n - 1) + 0.5);
+    nth_element(v, v + k, v + n);
+    return v[k];
+}
+
+int profileScopeStats(ProfileScopeStats* out, int max_out)
+{
+    int n = min(scopeCount.load(), max_out);
+    float sorted[HISTORY_FRAMES];
+    for (int i = 0; i < n; i++) {
+        const ScopeHistory& s = scopes[i];
+        ProfileScopeStats& st = out[i];
+        st.name = s.name;
+        st.last_ms = s.last_ms;
+        st.last_calls = s.last_calls;
+        st.samples = s.count;
+        st.p50 = st.p95 = st.p99 = 0.0f;
+        if (s.count > 0) {
+            memcpy(sorted, s.samples, s.count * sizeof(float));
+            st.p50 = percentile(sorted, s.count, 0.50);
+            st.p95 = percentile(sorted, s.count, 0.95);
+            st.p99 = percentile(sorted, s.count, 0.99);
+        }
+    }
+    return n;
+}
+
+int profileFrameEvents(const ProfileEvent** events, uint64_t* start, uint64_t* end)
+{
+    *events = frameEvents;
+    *start = lastFrameStart;
+    *end = lastFrameEnd;
+    return frameEventCount;
+}
+
+const char* profileScopeName(int slot)
+{
+    return (slot >= 0 && slot < scopeCount.load()) ? scopes[slot].name : "?";
+}
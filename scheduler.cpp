@@ -0,0 +1,671 @@
+#include "header.h"
+#include <algorithm>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+// Sampling scheduler.
+// Collectors run on one sampler thread, each on its own period, driven by a
+// two-level timer wheel. The thread sleeps in poll() on a timerfd armed for the
+// next coalesced wakeup (plus an eventfd to interrupt it), publishes results into
+// Sampler::shared and pushes an SDL event so the UI draws one frame for them.
+
+static uint64_t monotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// ---- Timer wheel ----
+// Level 0 has one slot per tick for the next SLOTS ticks, level 1 one slot per
+// SLOTS ticks for the next SLOTS*SLOTS ticks, and anything further out waits in
+// `overflow`. Level 1 slots are cascaded into level 0 as each revolution starts.
+
+void TimerWheel::reset(uint64_t now)
+{
+    tick = now / TICK_MS;
+}
+
+int TimerWheel::add(uint64_t interval, uint64_t slack, uint64_t now)
+{
+    WheelTimer t;
+    t.interval = interval;
+    t.slack = max(slack, TICK_MS); // a wakeup can only be shared if it may fire at least a tick late
+    t.deadline = now;
+    t.level = -1;
+    t.slot = 0;
+    timers.push_back(t);
+    int id = (int)timers.size() - 1;
+    place(id);
+    return id;
+}
+
+void TimerWheel::place(int id)
+{
+    WheelTimer& t = timers[id];
+    uint64_t due = (t.deadline + TICK_MS - 1) / TICK_MS;
+    if (due <= tick) due = tick + 1; // overdue: fire on the next tick
+
+    uint64_t delta = due - tick;
+    if (delta < SLOTS) {
+        t.level = 0;
+        t.slot = due % SLOTS;
+        level0[t.slot].push_back(id);
+        level0_count++;
+    } else if (delta < SLOTS * SLOTS) {
+        t.level = 1;
+        t.slot = (due / SLOTS) % SLOTS;
+        level1[t.slot].push_back(id);
+    } else {
+        t.level = 2;
+        overflow.push_back(id);
+    }
+}
+
+void TimerWheel::unplace(int id)
+{
+    WheelTimer& t = timers[id];
+    if (t.level < 0) return;
+    vector<int>* list = t.level == 0 ? &level0[t.slot] : t.level == 1 ? &level1[t.slot] : &overflow;
+    list->erase(remove(list->begin(), list->end(), id), list->end());
+    if (t.level == 0) level0_count--;
+    t.level = -1;
+}
+
+void TimerWheel::setInterval(int id, uint64_t interval, uint64_t now)
+{
+    WheelTimer& t = timers[id];
+    if (t.interval == interval) return;
+    // Keep the phase: the next run is one new interval after the previous one
+    uint64_t previous = t.deadline > t.interval ? t.deadline - t.interval : 0;
+    t.interval = interval;
+    t.deadline = max(previous + interval, now);
+    unplace(id);
+    place(id);
+}
+
+void TimerWheel::advance(uint64_t now, vector<int>& fired)
+{
+    uint64_t target = now / TICK_MS;
+    while (tick < target) {
+        // Nothing in level 0: skip ahead to the next cascade instead of ticking through
+        if (level0_count == 0) {
+            uint64_t next_revolution = (tick / SLOTS + 1) * SLOTS;
+            if (next_revolution > target) {
+                tick = target;
+                break;
+            }
+            tick = next_revolution - 1;
+        }
+
+        tick++;
+        if (tick % SLOTS == 0) {
+            if ((tick / SLOTS) % SLOTS == 0) {
+                vector<int> far;
+                far.swap(overflow);
+                for (int id : far) place(id);
+            }
+            vector<int>& cascade = level1[(tick / SLOTS) % SLOTS];
+            scratch.swap(cascade);
+            for (int id : scratch) place(id);
+            scratch.clear();
+        }
+
+        vector<int>& slot = level0[tick % SLOTS];
+        if (slot.empty()) continue;
+        scratch.swap(slot);
+        level0_count -= scratch.size();
+        for (int id : scratch) {
+            WheelTimer& t = timers[id];
+            fired.push_back(id);
+            // Periods stay exact; after a stall (suspend, paused sampler) skip the missed runs
+            t.deadline += t.interval;
+            if (t.deadline <= now) t.deadline = now + t.interval;
+            place(id);
+        }
+        scratch.clear();
+    }
+}
+
+uint64_t TimerWheel::nextWake() const
+{
+    // The wakeup is pushed as late as the earliest deadline+slack allows, so every
+    // timer due before then shares it. A level1 timer waits for the next cascade
+    // and may by then be due sooner than timers already in level0, so every level
+    // counts.
+    uint64_t latest = UINT64_MAX;
+    for (const vector<int>& slot : level1) {
+        for (int id : slot) latest = min(latest, timers[id].deadline + timers[id].slack);
+    }
+    for (int id : overflow) latest = min(latest, timers[id].deadline + timers[id].slack);
+    for (uint64_t t = tick + 1; t < tick + SLOTS; t++) {
+        if ((t - 1) * TICK_MS >= latest) break; // later slots can't be due by then
+        for (int id : level0[t % SLOTS]) {
+            latest = min(latest, timers[id].deadline + timers[id].slack);
+        }
+    }
+    if (latest == UINT64_MAX) return UINT64_MAX;
+    return max(latest / TICK_MS, tick + 1) * TICK_MS;
+}
+
+// ---- Adaptive rates ----
+
+static const int STABLE_SAMPLES = 3; // unchanged samples before backing off a step
+
+void AdaptiveRate::setup(double fast, double slow, double change)
+{
+    fastest = fast;
+    slowest = slow;
+    threshold = change;
+    interval = fast;
+    stable = 0;
+    has_last = false;
+    last = 0.0;
+}
+
+double AdaptiveRate::update(double value)
+{
+    // A change jumps most of the way to the fastest rate at once, so the samples
+    // right after a spike are dense; calm periods stretch the interval gradually
+    if (has_last && fabs(value - last) > threshold) {
+        interval = max(fastest, interval / 4.0);
+        stable = 0;
+    } else if (++stable >= STABLE_SAMPLES) {
+        interval = min(slowest, interval * 1.5);
+        stable = 0;
+    }
+    last = value;
+    has_last = true;
+    return interval;
+}
+
+// ---- Sampler ----
+
+struct SampleSchedule {
+    double interval; // seconds
+    double slack;
+};
+
+static const SampleSchedule schedules[SAMPLE_COUNT] = {
+    {0.1, 0.01},   // SAMPLE_CPU, follows the CPU graph FPS slider
+    {1.0, 0.1},    // SAMPLE_MEMORY
+    {2.0, 0.25},   // SAMPLE_DISK
+    {1.0, 0.1},    // SAMPLE_NETWORK
+    {0.2, 0.05},   // SAMPLE_SENSORS, governed
+    {0.25, 0.05},  // SAMPLE_TASKS, governed
+    {2.0, 0.25},   // SAMPLE_PROCESSES, governed
+    {1.0, 0.1},    // SAMPLE_THREADS
+    {0.5, 0.1},    // SAMPLE_SMAPS, entries themselves refresh every 5s
+    {1.0, 0.1},    // SAMPLE_DISKSTATS
+    {1.0, 0.25},   // SAMPLE_FILESYSTEMS, collects finished probes; each mount is probed every 5s
+    {0.5, 0.05},   // SAMPLE_PRESSURE
+    {2.0, 0.25},   // SAMPLE_CGROUPS, governed
+    {2.0, 0.25},   // SAMPLE_CMDLINES, governed
+};
+
+// Governor entry for the collectors it paces, or -1
+static int governedId(int id)
+{
+    switch (id) {
+        case SAMPLE_SENSORS: return GOV_SENSORS;
+        case SAMPLE_TASKS: return GOV_TASKS;
+        case SAMPLE_PROCESSES: return GOV_PROCESSES;
+        case SAMPLE_CGROUPS: return GOV_CGROUPS;
+        case SAMPLE_CMDLINES: return GOV_CMDLINE;
+        default: return -1;
+    }
+}
+
+// Interval of an adaptive metric while adaptive sampling is off: its fixed
+// schedule, or for CPU the rate the UI asked for, which is kept as `fastest`
+static double fixedInterval(int id, const AdaptiveRate& rate)
+{
+    return id == SAMPLE_CPU ? rate.fastest : schedules[id].interval;
+}
+
+Sampler::Sampler() : governor(nullptr), timer_fd(-1), wake_fd(-1), running(false), paused(false),
+                     event_pending(false), event_type(0), adaptive_enabled(true), cmdlines_wanted(false),
+                     have_prev_cpu(false), last_cpu_ms(0), have_prev_net(false), prev_net_bytes(0),
+                     last_net_ms(0), idle_applied(false), cmdline_index(make_shared<CmdlineIndex>()),
+                     cmdlines_synced(false)
+{
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        requested[i] = 0;
+        current_interval[i] = (uint64_t)(schedules[i].interval * 1000.0);
+    }
+
+    // Metrics that adapt; the value compared is the one collect() returns:
+    // CPU usage %, RAM used %, disk used %, network bytes/s over all interfaces
+    adaptive[SAMPLE_CPU].setup(0.1, 1.0, 5.0);
+    adaptive[SAMPLE_MEMORY].setup(0.25, 2.0, 1.0);
+    adaptive[SAMPLE_DISK].setup(1.0, 10.0, 0.5);
+    adaptive[SAMPLE_NETWORK].setup(0.25, 2.0, 256.0 * 1024.0);
+}
+
+void Sampler::start(Governor* gov, Uint32 sdl_event)
+{
+    governor = gov;
+    event_type = sdl_event;
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    uint64_t now = monotonicMs();
+    wheel.reset(now);
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        int governed = governedId(i);
+        double interval = governed >= 0 ? governor->interval(governed) : schedules[i].interval;
+        wheel.add((uint64_t)(interval * 1000.0), (uint64_t)(schedules[i].slack * 1000.0), now);
+    }
+
+    running = true;
+    worker = thread(&Sampler::run, this);
+}
+
+void Sampler::stop()
+{
+    if (!running) return;
+    running = false;
+    wake();
+    worker.join();
+    close(timer_fd);
+    close(wake_fd);
+}
+
+void Sampler::wake()
+{
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        // The counter is already non-zero, so the sampler will wake anyway
+    }
+}
+
+void Sampler::setInterval(int id, double seconds)
+{
+    requested[id] = (uint64_t)(seconds * 1000.0);
+    wake();
+}
+
+void Sampler::setExpanded(const vector<pair<int, long long>>& processes)
+{
+    lock_guard<mutex> guard(lock);
+    expanded = processes;
+}
+
+void Sampler::setMemoryWanted(const vector<pair<int, long long>>& processes)
+{
+    lock_guard<mutex> guard(lock);
+    memory_wanted = processes;
+}
+
+void Sampler::setCmdlinesWanted(bool on)
+{
+    if (cmdlines_wanted.exchange(on) == on) return;
+    // A new cmd~ filter shouldn't wait for the next sync to match anything
+    if (on) wake();
+}
+
+void Sampler::setPaused(bool on)
+{
+    if (paused == on) return;
+    paused = on;
+    wake();
+}
+
+bool Sampler::read(SampleSet& out, bool changed[SAMPLE_COUNT])
+{
+    lock_guard<mutex> guard(lock);
+    event_pending = false;
+    bool any = false;
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        changed[i] = shared.seq[i] != out.seq[i];
+        any = any || changed[i];
+        out.seq[i] = shared.seq[i];
+    }
+    if (!any) return false;
+
+    out.cpu_usage = shared.cpu_usage;
+    out.cpu_elapsed = shared.cpu_elapsed;
+    shared.cpu_elapsed = 0.0;
+    out.memory = shared.memory;
+    out.swap = shared.swap;
+    out.disk = shared.disk;
+    out.temperature = shared.temperature;
+    memcpy(out.fan_status, shared.fan_status, sizeof(out.fan_status));
+    out.fan_speed = shared.fan_speed;
+    memcpy(out.task_counts, shared.task_counts, sizeof(out.task_counts));
+    out.tasks = shared.tasks;
+    if (changed[SAMPLE_NETWORK]) {
+        out.interfaces = shared.interfaces;
+    }
+    if (changed[SAMPLE_THREADS]) {
+        out.threads = shared.threads;
+    }
+    if (changed[SAMPLE_SMAPS]) {
+        out.process_memory = shared.process_memory;
+    }
+    if (changed[SAMPLE_DISKSTATS]) {
+        out.diskstats = shared.diskstats;
+    }
+    if (changed[SAMPLE_FILESYSTEMS]) {
+        out.filesystems = shared.filesystems;
+    }
+    if (changed[SAMPLE_PRESSURE]) {
+        out.pressure = shared.pressure;
+    }
+    if (changed[SAMPLE_CGROUPS]) {
+        out.cgroups = shared.cgroups;
+        out.cgroup_members = shared.cgroup_members;
+    }
+    if (changed[SAMPLE_CMDLINES]) {
+        out.cmdlines = shared.cmdlines;
+    }
+    if (changed[SAMPLE_PROCESSES]) {
+        // The sampler refills the vector the UI gives back, reusing its storage
+        out.processes.swap(shared.processes);
+    }
+    return true;
+}
+
+double Sampler::collect(int id, uint64_t now_ms)
+{
+    double now = SDL_GetTicks() / 1000.0;
+    double value = 0.0;
+    switch (id) {
+    case SAMPLE_CPU: {
+        CPUStats stats = getCPUStats();
+        double usage = have_prev_cpu ? calculateCPUUsage(prev_cpu, stats) : 0.0;
+        double elapsed = have_prev_cpu ? (now_ms - last_cpu_ms) / 1000.0 : 0.0;
+        prev_cpu = stats;
+        have_prev_cpu = true;
+        last_cpu_ms = now_ms;
+        value = usage;
+        lock_guard<mutex> guard(lock);
+        shared.cpu_usage = usage;
+        shared.cpu_elapsed += elapsed;
+        break;
+    }
+    case SAMPLE_MEMORY: {
+        MemoryInfo memory = getMemoryInfo();
+        MemoryInfo swap = getSwapInfo();
+        value = memory.percentage;
+        lock_guard<mutex> guard(lock);
+        shared.memory = memory;
+        shared.swap = swap;
+        break;
+    }
+    case SAMPLE_DISK: {
+        DiskInfo disk = getDiskInfo("/");
+        value = disk.percentage;
+        lock_guard<mutex> guard(lock);
+        shared.disk = disk;
+        break;
+    }
+    case SAMPLE_NETWORK: {
+        pmr::vector<NetworkInterface> interfaces = getNetworkInterfaces(&pool);
+        long long bytes = 0;
+        for (const NetworkInterface& iface : interfaces) {
+            bytes += iface.rx_bytes + iface.tx_bytes;
+        }
+        if (have_prev_net && now_ms > last_net_ms) {
+            value = (bytes - prev_net_bytes) / ((now_ms - last_net_ms) / 1000.0);
+        }
+        have_prev_net = true;
+        prev_net_bytes = bytes;
+        last_net_ms = now_ms;
+        lock_guard<mutex> guard(lock);
+        shared.interfaces.assign(interfaces.begin(), interfaces.end());
+        break;
+    }
+    case SAMPLE_SENSORS: {
+        char fan_status[sizeof(shared.fan_status)];
+        double temperature;
+        int fan_speed;
+        {
+            GovernorRun run(*governor, GOV_SENSORS, now);
+            temperature = getThermalTemp();
+            getFanStatus(fan_status, sizeof(fan_status));
+            fan_speed = getFanSpeed();
+        }
+        lock_guard<mutex> guard(lock);
+        shared.temperature = temperature;
+        memcpy(shared.fan_status, fan_status, sizeof(fan_status));
+        shared.fan_speed = fan_speed;
+        break;
+    }
+    case SAMPLE_TASKS: {
+        GovernorRun run(*governor, GOV_TASKS, now);
+        TaskSummary tasks = getTaskSummary();
+        lock_guard<mutex> guard(lock);
+        shared.tasks = tasks;
+        break;
+    }
+    case SAMPLE_THREADS: {
+        vector<pair<int, long long>> wanted;
+        {
+            lock_guard<mutex> guard(lock);
+            wanted = expanded;
+        }
+        if (wanted.empty() && thread_groups.empty()) return value;
+
+        // Groups follow the expanded list; a collapsed process loses its history
+        vector<ProcessThreads> groups;
+        for (const pair<int, long long>& w : wanted) {
+            auto it = find_if(thread_groups.begin(), thread_groups.end(),
+                              [&](const ProcessThreads& g) { return g.pid == w.first; });
+            groups.push_back(it != thread_groups.end() ? move(*it) : ProcessThreads(w.first, w.second));
+        }
+        thread_groups.swap(groups);
+
+        long long total_time = readTotalCPUTime();
+        vector<ProcessThreads> published;
+        for (size_t i = 0; i < thread_groups.size(); i++) {
+            ProcessThreads& group = thread_groups[i];
+            if (!group.refresh(total_time, wanted[i].second)) continue;
+            published.emplace_back(group.pid, group.starttime);
+            vector<ThreadInfo>& threads = published.back().threads;
+            threads = group.threads;
+            stable_sort(threads.begin(), threads.end(),
+                        [](const ThreadInfo& a, const ThreadInfo& b) { return a.cpu_usage > b.cpu_usage; });
+        }
+        lock_guard<mutex> guard(lock);
+        shared.threads.swap(published);
+        break;
+    }
+    case SAMPLE_SMAPS: {
+        vector<pair<int, long long>> wanted;
+        {
+            lock_guard<mutex> guard(lock);
+            wanted = memory_wanted;
+        }
+        if (!memory_cache.update(move(wanted), now)) return value;
+        lock_guard<mutex> guard(lock);
+        shared.process_memory = memory_cache.entries;
+        break;
+    }
+    case SAMPLE_DISKSTATS: {
+        if (!diskstats_reader.update(diskstats, now_ms)) return value;
+        for (int i = 0; i < diskstats.count; i++) {
+            value = max(value, diskstats.devices[i].utilization);
+        }
+        lock_guard<mutex> guard(lock);
+        shared.diskstats = diskstats;
+        break;
+    }
+    case SAMPLE_FILESYSTEMS: {
+        if (!filesystems.update(now_ms)) return value;
+        lock_guard<mutex> guard(lock);
+        filesystems.publish(shared.filesystems);
+        break;
+    }
+    case SAMPLE_PRESSURE: {
+        if (!pressure_reader.update(pressure)) return value;
+        for (const PressureResourceStats& res : pressure.resources) {
+            value = max(value, res.some.rate);
+        }
+        lock_guard<mutex> guard(lock);
+        shared.pressure = pressure;
+        break;
+    }
+    case SAMPLE_CGROUPS: {
+        vector<CgroupInfo> infos;
+        {
+            GovernorRun run(*governor, GOV_CGROUPS, now);
+            if (!cgroups.update(process_keys)) return value;
+            infos.reserve(cgroups.nodes.size());
+            for (const CgroupMonitor::Node& node : cgroups.nodes) {
+                infos.push_back(node.info);
+            }
+        }
+        lock_guard<mutex> guard(lock);
+        shared.cgroups.swap(infos);
+        shared.cgroup_members = cgroups.members;
+        break;
+    }
+    case SAMPLE_CMDLINES: {
+        if (!cmdlines_wanted) {
+            cmdlines_synced = false;
+            return value;
+        }
+        {
+            GovernorRun run(*governor, GOV_CMDLINE, now);
+            bool first = !cmdlines_synced;
+            cmdlines_synced = true;
+            if (cmdline_index->matches(process_keys)) {
+                if (!first) return value;
+            } else {
+                // The UI may still be searching the published index; sync a copy then
+                if (cmdline_index.use_count() > 1) cmdline_index = make_shared<CmdlineIndex>(*cmdline_index);
+                cmdline_index->sync(process_keys);
+            }
+        }
+        lock_guard<mutex> guard(lock);
+        shared.cmdlines = cmdline_index;
+        break;
+    }
+    case SAMPLE_PROCESSES: {
+        {
+            GovernorRun run(*governor, GOV_PROCESSES, now);
+            getProcesses(processes, &run.worker_cpu);
+        }
+        // The per-state breakdown comes with the process scan rather than a scan of its own
+        int counts[4];
+        countTaskStates(processes, counts);
+        process_keys.clear();
+        for (const Proc& proc : processes) {
+            process_keys.emplace_back(proc.pid, proc.starttime);
+        }
+        lock_guard<mutex> guard(lock);
+        shared.processes.swap(processes);
+        memcpy(shared.task_counts, counts, sizeof(counts));
+        break;
+    }
+    }
+
+    lock_guard<mutex> guard(lock);
+    shared.seq[id]++;
+    return value;
+}
+
+void Sampler::run()
+{
+    pthread_setname_np(pthread_self(), "sampler");
+    vector<int> fired;
+
+    while (running) {
+        uint64_t now = monotonicMs();
+
+        // Settings from the UI thread
+        bool want_idle;
+        {
+            lock_guard<mutex> guard(governor->lock);
+            want_idle = governor->idle_priority;
+        }
+        if (want_idle != idle_applied && Governor::applyIdlePriority(want_idle)) {
+            idle_applied = want_idle;
+        }
+        for (int i = 0; i < SAMPLE_COUNT; i++) {
+            // For an adaptive metric the requested interval is its fastest rate
+            uint64_t interval = requested[i].exchange(0);
+            if (interval == 0) continue;
+            if (adaptive[i].fastest > 0.0) {
+                AdaptiveRate& rate = adaptive[i];
+                rate.fastest = interval / 1000.0;
+                rate.slowest = max(rate.slowest, rate.fastest);
+                rate.interval = min(max(rate.interval, rate.fastest), rate.slowest);
+                interval = (uint64_t)((adaptive_enabled ? rate.interval : fixedInterval(i, rate)) * 1000.0);
+            }
+            wheel.setInterval(i, interval, now);
+        }
+
+        if (!paused) {
+            fired.clear();
+            wheel.advance(now, fired);
+            // A changed mount table is picked up right away rather than on the next tick
+            if (filesystems.mounts_changed &&
+                find(fired.begin(), fired.end(), (int)SAMPLE_FILESYSTEMS) == fired.end()) {
+                fired.push_back(SAMPLE_FILESYSTEMS);
+            }
+            // Likewise the command line index for a filter that just started using it
+            if (cmdlines_wanted && !cmdlines_synced &&
+                find(fired.begin(), fired.end(), (int)SAMPLE_CMDLINES) == fired.end()) {
+                fired.push_back(SAMPLE_CMDLINES);
+            }
+            bool adapt = adaptive_enabled;
+            for (int id : fired) {
+                double value = collect(id, now);
+                AdaptiveRate& rate = adaptive[id];
+                if (rate.fastest > 0.0) {
+                    double interval = adapt ? rate.update(value) : fixedInterval(id, rate);
+                    wheel.setInterval(id, (uint64_t)(interval * 1000.0), now);
+                }
+            }
+
+            // One frame for everything collected in this wakeup
+            if (!fired.empty() && !event_pending.exchange(true)) {
+                SDL_Event event;
+                memset(&event, 0, sizeof(event));
+                event.type = event_type;
+                SDL_PushEvent(&event);
+            }
+
+            governor->adjust(SDL_GetTicks() / 1000.0);
+            for (int i = 0; i < SAMPLE_COUNT; i++) {
+                int governed = governedId(i);
+                if (governed >= 0) {
+                    wheel.setInterval(i, (uint64_t)(governor->interval(governed) * 1000.0), now);
+                }
+                current_interval[i] = wheel.timers[i].interval;
+            }
+        }
+
+        // Sleep until the coalesced deadline, or until poked through wake_fd
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        uint64_t wake_at = paused ? UINT64_MAX : wheel.nextWake();
+        if (wake_at != UINT64_MAX) {
+            spec.it_value.tv_sec = wake_at / 1000;
+            spec.it_value.tv_nsec = (wake_at % 1000) * 1000000;
+        }
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+
+        // mountinfo always polls readable; POLLPRI (with POLLERR) means the mount table changed
+        struct pollfd fds[3] = {{timer_fd, POLLIN, 0}, {wake_fd, POLLIN, 0},
+                                {filesystems.mountinfo_fd, POLLPRI, 0}};
+        if (poll(fds, 3, -1) > 0) {
+            uint64_t count;
+            if (fds[0].revents & POLLIN) {
+                if (::read(timer_fd, &count, sizeof(count)) < 0) count = 0;
+            }
+            if (fds[1].revents & POLLIN) {
+                if (::read(wake_fd, &count, sizeof(count)) < 0) count = 0;
+            }
+            if (fds[2].revents & (POLLPRI | POLLERR)) {
+                filesystems.mounts_changed = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#include "header.h"
+#include <string.h>
+
+// Self-monitoring: what the monitor itself costs, read from /proc/self
+
+// utime + stime (clock ticks) and comm from a /proc/.../stat line
+static bool parseTaskStat(const char* line, ThreadCPU& thread, long long& ticks)
+{
+    const char* first_paren = strchr(line, '(');
+    const char* last_paren = strrchr(line, ')');
+    if (first_paren == nullptr || last_paren == nullptr || last_paren < first_paren) {
+        return false;
+    }
+
+    size_t len = min((size_t)(last_paren - first_paren - 1), sizeof(thread.name) - 1);
+    memcpy(thread.name, first_paren + 1, len);
+    thread.name[len] = '\0';
+
+    // Field 3 (state) follows the comm; utime and stime are fields 14 and 15
+    const char* p = last_paren + 2;
+    for (int field = 3; field < 14 && *p; field++) {
+        while (*p && *p != ' ') p++;
+        while (*p == ' ') p++;
+    }
+    char* end;
+    long long utime = strtoll(p, &end, 10);
+    long long stime = strtoll(end, nullptr, 10);
+    ticks = utime + stime;
+    return true;
+}
+
+// Value of a "name: value" line in /proc/self/io
+static long long ioValue(const char* buf, const char* key)
+{
+    const char* p = strstr(buf, key);
+    return p ? strtoll(p + strlen(key), nullptr, 10) : 0;
+}
+
+void SelfMonitor::sample(double now)
+{
+    PROFILE_SCOPE("SelfMonitor::sample");
+    double elapsed = last_time > 0.0 ? now - last_time : 0.0;
+    static const long ticks_per_second = sysconf(_SC_CLK_TCK);
+    static const long page_size = sysconf(_SC_PAGESIZE);
+
+    // Per-thread CPU; tids are matched against the previous sample so a thread
+    // that started in between is measured from zero rather than its whole lifetime
+    static int task_dir = openDirFd("/proc/self/task");
+    static vector<int> tids;
+    size_t count = 0;
+    cpu_usage = 0.0;
+    if (listNumericEntries(task_dir, tids)) {
+        for (int tid : tids) {
+            char path[32];
+            char line[1024];
+            pidPath(path, tid, "stat");
+            if (readProcFileAt(task_dir, path, line, sizeof(line)) <= 0) continue;
+
+            ThreadCPU thread;
+            long long ticks;
+            thread.tid = tid;
+            if (!parseTaskStat(line, thread, ticks)) continue;
+            thread.ticks = ticks;
+            thread.cpu_usage = 0.0;
+            for (const ThreadCPU& prev : threads) {
+                if (prev.tid == tid && elapsed > 0.0) {
+                    thread.cpu_usage = (ticks - prev.ticks) / (elapsed * ticks_per_second) * 100.0;
+                    break;
+                }
+            }
+            cpu_usage += thread.cpu_usage;
+
+            if (count < next_threads.size()) {
+                next_threads[count] = thread;
+            } else {
+                next_threads.push_back(thread);
+            }
+            count++;
+        }
+    }
+    next_threads.resize(count);
+    threads.swap(next_threads);
+
+    // statm: size resident shared ... in pages
+    char buf[512];
+    if (readProcFile("/proc/self/statm", buf, sizeof(buf)) > 0) {
+        long long pages = 0;
+        sscanf(buf, "%*d %lld", &pages);
+        rss = pages * page_size;
+    }
+
+    // syscr/syscw count read- and write-family syscalls only, which is where
+    // a /proc scraper spends nearly all of its syscalls
+    long long syscr = 0, syscw = 0;
+    if (readProcFile("/proc/self/io", buf, sizeof(buf)) > 0) {
+        syscr = ioValue(buf, "syscr:");
+        syscw = ioValue(buf, "syscw:");
+    }
+
+#ifdef MONITOR_TRACK_ALLOC
+    long long allocs = allocTotals().allocs;
+    allocs_tracked = true;
+#else
+    long long allocs = 0;
+    allocs_tracked = false;
+#endif
+
+    if (elapsed > 0.0) {
+        syscalls_read_rate = (syscr - prev_syscr) / elapsed;
+        syscalls_write_rate = (syscw - prev_syscw) / elapsed;
+        allocs_rate = (allocs - prev_allocs) / elapsed;
+    }
+    prev_syscr = syscr;
+    prev_syscw = syscw;
+    prev_allocs = allocs;
+    last_time = now;
+
+    if (cpu_history.size() >= SELF_HISTORY) {
+        cpu_history.erase(cpu_history.begin());
+    }
+    cpu_history.push_back((float)cpu_usage);
+}
+
+bool SelfMonitor::overBudget() const
+{
+    return cpu_usage > cpu_budget || rss > (long long)(rss_budget_mb * 1024.0 * 1024.0);
+}
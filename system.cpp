@@ -1,7 +1,8 @@
 #include "header.h"
 #include <string.h>
 #include <pwd.h>
-#include <sstream>
+#include <fcntl.h>
+#include <sys/syscall.h>
 
 // get cpu id and information, you can use `proc/cpuinfo`
 string CPUinfo()
@@ -74,19 +75,122 @@ string getLoggedUser()
     return "Unknown";
 }
 
+// Read a small /proc or /sys file into `buf` without iostreams or heap allocation.
+// The contents are NUL-terminated (truncated to size - 1); returns the length or -1.
+ssize_t readProcFile(const char* path, char* buf, size_t size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    size_t len = 0;
+    while (len < size - 1) {
+        ssize_t n = read(fd, buf + len, size - 1 - len);
+        if (n <= 0) break;
+        len += n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return len;
+}
+
+// Same as readProcFile() for a path relative to the directory `dir_fd`, so the
+// kernel resolves one or two components instead of the whole absolute path
+ssize_t readProcFileAt(int dir_fd, const char* path, char* buf, size_t size)
+{
+    int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    size_t len = 0;
+    while (len < size - 1) {
+        ssize_t n = read(fd, buf + len, size - 1 - len);
+        if (n <= 0) break;
+        len += n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return len;
+}
+
+int openDirFd(const char* path)
+{
+    return open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+// Shared /proc fd for openat()/fstatat(); those don't use the file position,
+// so any thread may use it. Listing needs a descriptor of its own.
+int procFd()
+{
+    static int fd = openDirFd("/proc");
+    return fd;
+}
+
+// Record layout returned by getdents64 (not exported by older glibc headers)
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+bool listNumericEntries(int dir_fd, vector<int>& ids)
+{
+    ids.clear();
+    if (dir_fd < 0 || lseek(dir_fd, 0, SEEK_SET) < 0) return false;
+
+    // A few hundred entries per syscall, against one getdents per 32KB libc buffer
+    // plus a readdir() call and strlen/atoi per name
+    alignas(8) char buf[32768];
+    while (true) {
+        long n = syscall(SYS_getdents64, dir_fd, buf, sizeof(buf));
+        if (n < 0) return false;
+        if (n == 0) break;
+        for (long pos = 0; pos < n;) {
+            const LinuxDirent64* entry = (const LinuxDirent64*)(buf + pos);
+            pos += entry->d_reclen;
+
+            const char* p = entry->d_name;
+            if (*p < '0' || *p > '9') continue;
+            int id = 0;
+            while (*p >= '0' && *p <= '9') id = id * 10 + (*p++ - '0');
+            if (*p == '\0') ids.push_back(id);
+        }
+    }
+    return true;
+}
+
+int pidPath(char* out, int pid, const char* file)
+{
+    // Digits are produced backwards, then copied in order
+    char digits[12];
+    int n = 0;
+    do {
+        digits[n++] = '0' + pid % 10;
+        pid /= 10;
+    } while (pid > 0);
+
+    int len = 0;
+    while (n > 0) out[len++] = digits[--n];
+    if (file != nullptr) {
+        out[len++] = '/';
+        while (*file) out[len++] = *file++;
+    }
+    out[len] = '\0';
+    return len;
+}
+
 // Read CPU stats from /proc/stat
 CPUStats getCPUStats()
 {
+    PROFILE_SCOPE("getCPUStats");
     CPUStats stats = {0};
-    ifstream file("/proc/stat");
-    string line;
-
-    if (getline(file, line)) {
-        istringstream iss(line);
-        string cpu;
-        iss >> cpu >> stats.user >> stats.nice >> stats.system >> stats.idle
-            >> stats.iowait >> stats.irq >> stats.softirq >> stats.steal
-            >> stats.guest >> stats.guestNice;
+    // Only the first ("cpu") line is needed, which always fits
+    char buf[512];
+    if (readProcFile("/proc/stat", buf, sizeof(buf)) > 0) {
+        sscanf(buf, "cpu %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+               &stats.user, &stats.nice, &stats.system, &stats.idle,
+               &stats.iowait, &stats.irq, &stats.softirq, &stats.steal,
+               &stats.guest, &stats.guestNice);
     }
 
     return stats;
@@ -112,134 +216,103 @@ double calculateCPUUsage(const CPUStats& prev, const CPUStats& curr)
     return (double)(totalDiff - idleDiff) / totalDiff * 100.0;
 }
 
-// Get task counts from /proc/stat and process directories
-vector<int> getTaskCounts()
+// Count processes per state bucket: [running, sleeping, stopped, zombie]
+void countTaskStates(const vector<Proc>& processes, int counts[4])
 {
-    static vector<int> smoothed_counts(4, 0); // Smoothed values
-    static vector<int> last_counts(4, 0);     // Previous raw values
-    static int update_counter = 0;            // Update frequency control
-
-    vector<int> counts(4, 0); // [running, sleeping, stopped, zombie]
-
-    DIR* proc_dir = opendir("/proc");
-    if (!proc_dir) return counts;
-
-    struct dirent* entry;
-    while ((entry = readdir(proc_dir)) != nullptr) {
-        // Check if directory name is a number (PID)
-        if (strspn(entry->d_name, "0123456789") == strlen(entry->d_name)) {
-            string stat_path = "/proc/" + string(entry->d_name) + "/stat";
-            ifstream stat_file(stat_path);
-
-            if (stat_file.is_open()) {
-                string line;
-                if (getline(stat_file, line) && !line.empty()) {
-                    // Find the state field - it's the 3rd field after PID and comm
-                    // comm can contain spaces and parentheses, so we need to parse carefully
-                    size_t first_paren = line.find('(');
-                    size_t last_paren = line.rfind(')');
-
-                    if (first_paren != string::npos && last_paren != string::npos && last_paren > first_paren) {
-                        // Extract everything after the last parenthesis
-                        string after_comm = line.substr(last_paren + 1);
-                        istringstream iss(after_comm);
-                        string state;
-                        iss >> state; // First field after comm is the state
-
-                        if (!state.empty()) {
-                            char s = state[0];
-                            switch (s) {
-                                case 'R': counts[0]++; break; // Running
-                                case 'S': case 'D': case 'I': counts[1]++; break; // Sleeping (including idle and uninterruptible)
-                                case 'T': case 't': counts[2]++; break; // Stopped
-                                case 'Z': counts[3]++; break; // Zombie
-                                default:
-                                    // Handle any other states as sleeping
-                                    counts[1]++;
-                                    break;
-                            }
-                        }
-                    }
-                }
-            }
+    counts[0] = counts[1] = counts[2] = counts[3] = 0;
+    for (const Proc& proc : processes) {
+        switch (proc.state) {
+            case 'R': counts[0]++; break; // Running
+            case 'T': case 't': counts[2]++; break; // Stopped
+            case 'Z': counts[3]++; break; // Zombie
+            default:
+                // Sleeping, including idle (I) and uninterruptible (D)
+                counts[1]++;
+                break;
         }
     }
+}
 
-    closedir(proc_dir);
-
-    // Implement smoothing to prevent flickering
-    update_counter++;
-
-    // Update smoothed values every 5 calls (reduces update frequency)
-    if (update_counter >= 5) {
-        update_counter = 0;
-
-        // Apply exponential smoothing: new_value = 0.7 * current + 0.3 * previous
-        for (int i = 0; i < 4; i++) {
-            // Only update if change is significant (more than 2 processes)
-            if (abs(counts[i] - last_counts[i]) > 2) {
-                smoothed_counts[i] = (int)(0.7 * counts[i] + 0.3 * smoothed_counts[i]);
-            }
-            last_counts[i] = counts[i];
-        }
+// Runnable/blocked/total thread counts, kept up by the kernel, so this costs two
+// small reads instead of a stat file per process
+TaskSummary getTaskSummary()
+{
+    PROFILE_SCOPE("getTaskSummary");
+    TaskSummary summary = {0, 0, 0};
+
+    // procs_running and procs_blocked come after the per-CPU and intr lines, and
+    // the intr line alone can be tens of kB on big machines, so the buffer grows
+    // until the whole file fits. Only the sampler thread calls this.
+    static vector<char> buf(16384);
+    ssize_t len;
+    while ((len = readProcFile("/proc/stat", buf.data(), buf.size())) >= (ssize_t)buf.size() - 1) {
+        buf.resize(buf.size() * 2);
     }
-
-    // Return smoothed values if they exist, otherwise return current counts
-    if (smoothed_counts[0] == 0 && smoothed_counts[1] == 0 &&
-        smoothed_counts[2] == 0 && smoothed_counts[3] == 0) {
-        // First run - initialize smoothed values
-        smoothed_counts = counts;
-        return counts;
+    if (len > 0) {
+        const char* p = strstr(buf.data(), "\nprocs_running ");
+        if (p) summary.running = atoi(p + 15);
+        p = strstr(buf.data(), "\nprocs_blocked ");
+        if (p) summary.blocked = atoi(p + 15);
     }
 
-    return smoothed_counts;
+    // "0.10 0.05 0.01 2/345 6789": runnable/total scheduling entities in field 4
+    char line[128];
+    if (readProcFile("/proc/loadavg", line, sizeof(line)) > 0) {
+        const char* slash = strchr(line, '/');
+        if (slash) summary.threads = atoi(slash + 1);
+    }
+    return summary;
 }
 
 // Get thermal temperature
 double getThermalTemp()
 {
-    ifstream temp_file("/sys/class/thermal/thermal_zone0/temp");
-    if (temp_file.is_open()) {
-        int temp_millidegrees;
-        temp_file >> temp_millidegrees;
+    PROFILE_SCOPE("getThermalTemp");
+    char buf[32];
+    if (readProcFile("/sys/class/thermal/thermal_zone0/temp", buf, sizeof(buf)) > 0) {
+        int temp_millidegrees = atoi(buf);
         return temp_millidegrees / 1000.0; // Convert to Celsius
     }
     return 0.0;
 }
 
-// Get fan status
-string getFanStatus()
+// Get fan status, written into `buf`
+const char* getFanStatus(char* buf, size_t size)
 {
+    PROFILE_SCOPE("getFanStatus");
     // Try ACPI fan interface first
-    ifstream fan_file("/proc/acpi/fan/FAN0/state");
-    if (fan_file.is_open()) {
-        string line;
-        getline(fan_file, line);
-        if (line.find("on") != string::npos) {
-            return "Active";
-        } else if (line.find("off") != string::npos) {
-            return "Inactive";
+    char state[128];
+    if (readProcFile("/proc/acpi/fan/FAN0/state", state, sizeof(state)) >= 0) {
+        char* newline = strchr(state, '\n');
+        if (newline) *newline = '\0';
+        if (strstr(state, "on") != nullptr) {
+            snprintf(buf, size, "Active");
+            return buf;
+        } else if (strstr(state, "off") != nullptr) {
+            snprintf(buf, size, "Inactive");
+            return buf;
         }
     }
 
     // Try hwmon interface - if fan speed > 0, it's active
     int speed = getFanSpeed();
     if (speed > 0) {
-        return "Active (" + to_string(speed) + " RPM)";
+        snprintf(buf, size, "Active (%d RPM)", speed);
     } else if (speed == 0) {
-        return "Inactive (0 RPM)";
+        snprintf(buf, size, "Inactive (0 RPM)");
     } else if (speed == -1) {
-        return "Not Detected";
+        snprintf(buf, size, "Not Detected");
+    } else {
+        snprintf(buf, size, "Unknown");
     }
-
-    return "Unknown";
+    return buf;
 }
 
 // Get fan speed (RPM)
 int getFanSpeed()
 {
     // Try comprehensive fan speed locations
-    vector<string> fan_paths = {
+    static const char* fan_paths[] = {
         "/sys/class/hwmon/hwmon0/fan1_input",
         "/sys/class/hwmon/hwmon1/fan1_input",
         "/sys/class/hwmon/hwmon2/fan1_input",
@@ -258,32 +331,23 @@ int getFanSpeed()
         "/proc/acpi/ibm/fan"  // ThinkPad specific
     };
 
-    for (const string& path : fan_paths) {
-        ifstream fan_file(path);
-        if (fan_file.is_open()) {
-            if (path.find("ibm/fan") != string::npos) {
-                // ThinkPad fan format: "speed: 3456"
-                string line;
-                while (getline(fan_file, line)) {
-                    if (line.find("speed:") != string::npos) {
-                        size_t pos = line.find("speed:");
-                        if (pos != string::npos) {
-                            string speed_str = line.substr(pos + 6);
-                            try {
-                                return stoi(speed_str);
-                            } catch (...) {
-                                continue;
-                            }
-                        }
-                    }
-                }
-            } else {
-                // Standard hwmon format
-                int speed;
-                if (fan_file >> speed) {
-                    if (speed > 0) return speed;
-                }
+    char buf[512];
+    for (const char* path : fan_paths) {
+        if (readProcFile(path, buf, sizeof(buf)) <= 0) {
+            continue;
+        }
+        if (strstr(path, "ibm/fan") != nullptr) {
+            // ThinkPad fan format: "speed: 3456"
+            const char* pos = strstr(buf, "speed:");
+            if (pos != nullptr) {
+                char* end = nullptr;
+                long speed = strtol(pos + 6, &end, 10);
+                if (end != pos + 6) return (int)speed;
             }
+        } else {
+            // Standard hwmon format
+            int speed = atoi(buf);
+            if (speed > 0) return speed;
         }
     }
 
@@ -0,0 +1,88 @@
+#include "header.h"
+#include <algorithm>
+#include <fcntl.h>
+
+// Per-thread drill-down for expanded rows of the process table.
+// Only processes the user expanded are read, on the sampler thread; each keeps
+// its threads sorted by tid so the next refresh can diff CPU time against them,
+// the same way getProcesses() does with its pid states.
+
+// comm, state, utime + stime and last CPU (field 39) from a task stat line
+static bool parseThreadStat(const char* line, ThreadInfo& thread)
+{
+    const char* first_paren = strchr(line, '(');
+    const char* last_paren = strrchr(line, ')');
+    if (first_paren == nullptr || last_paren == nullptr || last_paren < first_paren) {
+        return false;
+    }
+    thread.name.assign(first_paren + 1, last_paren - first_paren - 1);
+
+    const char* p = last_paren + 1;
+    while (*p == ' ') p++;
+    thread.state = *p;
+
+    long long utime = 0, stime = 0;
+    int field = 3;
+    while (*p && field < 39) {
+        while (*p && *p != ' ') p++;
+        while (*p == ' ') p++;
+        field++;
+        if (field == 14) utime = strtoll(p, nullptr, 10);
+        else if (field == 15) stime = strtoll(p, nullptr, 10);
+    }
+    if (field < 39) return false;
+    thread.cpu_time = utime + stime;
+    thread.last_cpu = atoi(p);
+    return true;
+}
+
+static bool threadTidLess(const ThreadInfo& thread, int tid)
+{
+    return thread.tid < tid;
+}
+
+bool ProcessThreads::refresh(long long total_time, long long start)
+{
+    char path[32];
+    pidPath(path, pid, "task");
+    int task_dir = openat(procFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (task_dir < 0) return false;
+
+    // A reused pid is a different process; its threads start from zero
+    if (start != starttime) {
+        threads.clear();
+        prev_total_time = 0;
+        starttime = start;
+    }
+
+    long long total_diff = total_time - prev_total_time;
+    listNumericEntries(task_dir, tids);
+    next.resize(tids.size());
+    size_t count = 0;
+    for (int tid : tids) {
+        char line[1024];
+        pidPath(path, tid, "stat");
+        if (readProcFileAt(task_dir, path, line, sizeof(line)) <= 0) continue;
+
+        ThreadInfo& thread = next[count];
+        thread.tid = tid;
+        if (!parseThreadStat(line, thread)) continue;
+
+        // Same basis as the process table: share of all CPU time since the last refresh
+        thread.cpu_usage = 0.0;
+        auto prev = lower_bound(threads.begin(), threads.end(), tid, threadTidLess);
+        if (prev != threads.end() && prev->tid == tid && prev_total_time > 0 && total_diff > 0) {
+            thread.cpu_usage = max(0.0, (double)(thread.cpu_time - prev->cpu_time) / total_diff * 100.0);
+        }
+        count++;
+    }
+    close(task_dir);
+
+    next.resize(count);
+    if (!is_sorted(next.begin(), next.end(), [](const ThreadInfo& a, const ThreadInfo& b) { return a.tid < b.tid; })) {
+        sort(next.begin(), next.end(), [](const ThreadInfo& a, const ThreadInfo& b) { return a.tid < b.tid; });
+    }
+    threads.swap(next);
+    prev_total_time = total_time;
+    return true;
+}
@@ -0,0 +1,253 @@
+#include "header.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Batched small-file reads over io_uring, through the raw syscalls so there is
+// no liburing dependency. A batch goes through the ring in three rounds (open
+// everything, read everything, close everything), i.e. three io_uring_enter()
+// calls for up to URING_BATCH files instead of open/read/read/close each.
+// Anything that fails here (old kernel, io_uring blocked by seccomp or
+// io_uring_disabled) just returns false and the caller reads synchronously.
+// OPENAT, STATX, READ and CLOSE arrived in 5.6; a ring from an older kernel
+// would fail each of them with -EINVAL, so they are probed for at setup.
+
+static const uint8_t uringOpcodes[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE};
+
+static const unsigned URING_ENTRIES = 2 * URING_BATCH; // statx + open in the first round
+
+struct Uring {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_map;
+    size_t sq_map_size;
+    size_t sqes_size;
+
+    Uring() : fd(-1) {}
+    ~Uring() { destroy(); }
+
+    bool init()
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+        if (fd < 0) return false;
+
+        // Kernels from 5.4 on map the SQ and CQ rings in one go, and 5.6 added
+        // the probe; before that IORING_REGISTER_PROBE fails and so does this
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !supportsOpcodes()) {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        sq_map_size = max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                          params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+        sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+        sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        void* sqe_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_SQES);
+        if (sq_map == MAP_FAILED || sqe_map == MAP_FAILED) {
+            if (sq_map != MAP_FAILED) munmap(sq_map, sq_map_size);
+            if (sqe_map != MAP_FAILED) munmap(sqe_map, sqes_size);
+            close(fd);
+            fd = -1;
+            return false;
+        }
+
+        char* sq = (char*)sq_map;
+        sq_head = (unsigned*)(sq + params.sq_off.head);
+        sq_tail = (unsigned*)(sq + params.sq_off.tail);
+        sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq + params.sq_off.array);
+        sqes = (struct io_uring_sqe*)sqe_map;
+        cq_head = (unsigned*)(sq + params.cq_off.head);
+        cq_tail = (unsigned*)(sq + params.cq_off.tail);
+        cq_mask = (unsigned*)(sq + params.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe*)(sq + params.cq_off.cqes);
+        return true;
+    }
+
+    bool supportsOpcodes()
+    {
+        // struct io_uring_probe ends in a flexible array of one entry per opcode
+        const unsigned ops = 256;
+        vector<char> buf(sizeof(struct io_uring_probe) + ops * sizeof(struct io_uring_probe_op), 0);
+        struct io_uring_probe* probe = (struct io_uring_probe*)buf.data();
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, ops) < 0) return false;
+        for (uint8_t op : uringOpcodes) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    void destroy()
+    {
+        if (fd < 0) return;
+        munmap(sqes, sqes_size);
+        munmap(sq_map, sq_map_size);
+        close(fd);
+        fd = -1;
+    }
+
+    // Next free submission entry, zeroed; only called with room in the ring
+    struct io_uring_sqe* next(uint64_t user_data)
+    {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        struct io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = user_data;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    // Submits `count` queued entries and waits for all of their completions,
+    // handing each to `complete(user_data, res)`
+    template <typename F>
+    bool submitAndWait(unsigned count, F complete)
+    {
+        unsigned submitted = 0;
+        unsigned reaped = 0;
+        while (reaped < count) {
+            unsigned to_submit = count - submitted;
+            int ret = (int)syscall(__NR_io_uring_enter, fd, to_submit, count - reaped,
+                                   IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            submitted += ret;
+
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                const struct io_uring_cqe& cqe = cqes[head & *cq_mask];
+                complete(cqe.user_data, cqe.res);
+                reaped++;
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+};
+
+static atomic<bool> uringEnabled(false);
+static atomic<bool> uringBroken(false);   // set once setup failed; no point retrying per thread
+
+void setUseUring(bool on)
+{
+    uringEnabled = on;
+}
+
+bool useUring()
+{
+    return uringEnabled && !uringBroken;
+}
+
+bool uringUnavailable()
+{
+    return uringBroken;
+}
+
+bool uringReadBatch(UringRead* reads, int count)
+{
+    if (!useUring() || count > (int)URING_BATCH) return false;
+
+    // One ring per scanning thread, so submissions never need a lock
+    static thread_local Uring ring;
+    static thread_local bool ring_tried = false;
+    if (ring.fd < 0) {
+        if (ring_tried) return false;
+        ring_tried = true;
+        if (!ring.init()) {
+            uringBroken = true;
+            return false;
+        }
+    }
+
+    static thread_local int fds[URING_BATCH];
+    const uint64_t STATX_TAG = 1ull << 32;
+
+    // Round 1: open every file, and statx() the ones that want an owner
+    unsigned queued = 0;
+    for (int i = 0; i < count; i++) {
+        UringRead& r = reads[i];
+        r.length = -1;
+        fds[i] = -1;
+        struct io_uring_sqe* sqe = ring.next(i);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = r.dir_fd;
+        sqe->addr = (uint64_t)(uintptr_t)r.path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        queued++;
+        if (r.stat_path != nullptr) {
+            r.stx.stx_uid = (uint32_t)-1;
+            sqe = ring.next(STATX_TAG | i);
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = r.dir_fd;
+            sqe->addr = (uint64_t)(uintptr_t)r.stat_path;
+            sqe->len = STATX_UID;
+            sqe->off = (uint64_t)(uintptr_t)&r.stx;
+            queued++;
+        }
+    }
+    bool ok = ring.submitAndWait(queued, [&](uint64_t tag, int res) {
+        if (tag & STATX_TAG) {
+            if (res < 0) reads[tag & 0xffffffff].stx.stx_uid = (uint32_t)-1;
+        } else {
+            fds[tag] = res;
+        }
+    });
+
+    // Round 2: one read each; /proc files hand out their whole content in the
+    // first read as long as the buffer is big enough
+    queued = 0;
+    for (int i = 0; ok && i < count; i++) {
+        if (fds[i] < 0) continue;
+        struct io_uring_sqe* sqe = ring.next(i);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[i];
+        sqe->addr = (uint64_t)(uintptr_t)reads[i].buf;
+        sqe->len = reads[i].size - 1;
+        queued++;
+    }
+    ok = ok && ring.submitAndWait(queued, [&](uint64_t tag, int res) {
+        UringRead& r = reads[tag];
+        r.length = res;
+        r.buf[res > 0 ? res : 0] = '\0';
+    });
+
+    // Round 3: close; done synchronously if the ring gave up halfway so no fd leaks
+    queued = 0;
+    for (int i = 0; i < count; i++) {
+        if (fds[i] < 0) continue;
+        if (!ok) {
+            close(fds[i]);
+            continue;
+        }
+        struct io_uring_sqe* sqe = ring.next(i);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fds[i];
+        queued++;
+    }
+    if (ok) ok = ring.submitAndWait(queued, [](uint64_t, int) {});
+
+    // A ring that failed mid-batch may still hold entries; don't reuse it
+    if (!ok) {
+        ring.destroy();
+        uringBroken = true;
+    }
+    return ok;
+}